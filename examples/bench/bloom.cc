@@ -0,0 +1,117 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Measures the false-positive rates of 64, 128, and 256 bit Bloom filters for
+// clause-like term sets of a given size, using the BloomStats counters.
+//
+// Usage: bench-bloom [set-size [n-terms [n-queries [seed]]]]
+
+#define LIMBO_BLOOM_STATS
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <limbo/term.h>
+
+#include <limbo/internal/bloom.h>
+
+#include "timer.h"
+
+using limbo::Symbol;
+using limbo::Term;
+using limbo::internal::BloomSet;
+using limbo::internal::BloomStats;
+
+typedef std::vector<Term> TermSet;
+
+static bool Contains(const TermSet& s, Term t) { return std::find(s.begin(), s.end(), t) != s.end(); }
+
+static bool SubsetOf(const TermSet& s, const TermSet& r) {
+  return std::all_of(s.begin(), s.end(), [&r](Term t) { return Contains(r, t); });
+}
+
+template<size_t Bits>
+static void Run(const std::vector<TermSet>& sets, const std::vector<Term>& terms, size_t n_queries, size_t seed) {
+  std::vector<BloomSet<Term, Bits>> blooms(sets.size());
+  for (size_t i = 0; i < sets.size(); ++i) {
+    for (Term t : sets[i]) {
+      blooms[i].Add(t);
+    }
+  }
+  BloomStats* stats = BloomStats::Instance();
+  stats->Reset();
+  std::mt19937 gen(seed);
+  Timer timer;
+  timer.start();
+  for (size_t q = 0; q < n_queries; ++q) {
+    const size_t i = gen() % sets.size();
+    const size_t j = gen() % sets.size();
+    const Term t = terms[gen() % terms.size()];
+    if (blooms[i].PossiblyContains(t)) {
+      BloomStats::Record(BloomStats::kContains, [&]() { return Contains(sets[i], t); });
+    }
+    if (blooms[i].PossiblySubsetOf(blooms[j])) {
+      BloomStats::Record(BloomStats::kSubsetOf, [&]() { return SubsetOf(sets[i], sets[j]); });
+    }
+  }
+  timer.stop();
+  auto rate = [stats](BloomStats::Query q) {
+    const double n = stats->positives(q);
+    return n > 0 ? stats->false_positives(q) / n : 0.0;
+  };
+  std::cout << Bits << " bits: "
+            << "contains " << stats->false_positives(BloomStats::kContains) << "/"
+            << stats->positives(BloomStats::kContains) << " (" << rate(BloomStats::kContains) << "), "
+            << "subset-of " << stats->false_positives(BloomStats::kSubsetOf) << "/"
+            << stats->positives(BloomStats::kSubsetOf) << " (" << rate(BloomStats::kSubsetOf) << "), "
+            << timer.duration() << " seconds" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t set_size = 8;
+  size_t n_terms = 1000;
+  size_t n_queries = 1000000;
+  size_t seed = 0;
+  if (argc >= 2) {
+    set_size = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_terms = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_queries = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    seed = atoi(argv[4]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  std::vector<Term> terms;
+  for (size_t i = 0; i < n_terms; ++i) {
+    terms.push_back(tf.CreateTerm(sf.CreateFunction(sort, 0), {}));
+  }
+  // Sets are drawn from a small window of terms so that subsets actually
+  // occur.
+  std::mt19937 gen(seed);
+  std::vector<TermSet> sets(1000);
+  for (TermSet& s : sets) {
+    const size_t offset = gen() % (n_terms - std::min(n_terms, 2 * set_size) + 1);
+    while (s.size() < set_size) {
+      const Term t = terms[offset + gen() % std::min(n_terms, 2 * set_size)];
+      if (!Contains(s, t)) {
+        s.push_back(t);
+      }
+    }
+  }
+
+  Run<64>(sets, terms, n_queries, seed);
+  Run<128>(sets, terms, n_queries, seed);
+  Run<256>(sets, terms, n_queries, seed);
+  return 0;
+}
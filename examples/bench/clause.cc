@@ -0,0 +1,99 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Creates, copies, and destroys clauses of the sizes that occur in grounded
+// cardinality constraints like those of the minesweeper example, and reports
+// the time and the PoolStats counters. The inline size is chosen at compile
+// time with -DLIMBO_CLAUSE_INLINE_SIZE=n.
+//
+// Usage: bench-clause [max-size [n-clauses [n-rounds [seed]]]]
+
+#define LIMBO_POOL_STATS
+
+#include <cstdlib>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/term.h>
+
+#include <limbo/internal/pool.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Symbol;
+using limbo::Term;
+using limbo::internal::PoolStats;
+
+int main(int argc, char *argv[]) {
+  size_t max_size = 16;
+  size_t n_clauses = 10000;
+  size_t n_rounds = 100;
+  size_t seed = 0;
+  if (argc >= 2) {
+    max_size = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_clauses = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    seed = atoi(argv[4]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  const Term n = tf.CreateTerm(sf.CreateName(sort));
+  std::vector<Literal> lits;
+  for (size_t i = 0; i < 4 * max_size; ++i) {
+    const Term f = tf.CreateTerm(sf.CreateFunction(sort, 0), {});
+    lits.push_back(Literal::Eq(f, n));
+    lits.push_back(Literal::Neq(f, n));
+  }
+
+  std::mt19937 gen(seed);
+  std::vector<std::vector<Literal>> sets(n_clauses);
+  for (std::vector<Literal>& s : sets) {
+    const size_t size = 1 + gen() % max_size;
+    const size_t offset = gen() % (lits.size() - size + 1);
+    s.assign(lits.begin() + offset, lits.begin() + offset + size);
+  }
+
+  PoolStats* stats = PoolStats::Instance();
+  stats->Reset();
+  Timer timer;
+  timer.start();
+  std::vector<Clause> clauses;
+  for (size_t r = 0; r < n_rounds; ++r) {
+    clauses.clear();
+    for (const std::vector<Literal>& s : sets) {
+      clauses.push_back(Clause(s.begin(), s.end()));
+    }
+    std::vector<Clause> copies(clauses.begin(), clauses.end());
+    for (size_t i = 0; i < copies.size(); ++i) {
+      copies[i] = clauses[gen() % clauses.size()];
+    }
+  }
+  timer.stop();
+
+  std::cout << "inline size " << LIMBO_CLAUSE_INLINE_SIZE << ": "
+            << stats->allocations() << " allocations, "
+            << stats->reuses() << " reused, "
+            << stats->retained() << " bytes retained, "
+            << timer.duration() << " seconds" << std::endl;
+  std::cout << "clause sizes:";
+  for (size_t i = 0; i < PoolStats::kSizes; ++i) {
+    if (stats->sizes(i) > 0) {
+      std::cout << " " << i << ":" << stats->sizes(i);
+    }
+  }
+  std::cout << std::endl;
+  return 0;
+}
@@ -0,0 +1,88 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Measures how grounding scales with Grounder::set_n_threads(): a clause
+// P(x) /= T v Q(x,y) = T v R(y) /= T is grounded for n-names names, and then
+// n-names new names are added by unit clauses R(n) = T, which regrounds the
+// clause for all of them. Reports the time and the number of setup clauses
+// for 1, 2, 4, ... threads; the latter must be the same for all.
+//
+// Usage: bench-ground [max-threads [n-names [n-rounds]]]
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/grounder.h>
+#include <limbo/literal.h>
+#include <limbo/solver.h>
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Solver;
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t max_threads = std::thread::hardware_concurrency();
+  size_t n_names = 100;
+  size_t n_rounds = 3;
+  if (argc >= 2) {
+    max_threads = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_names = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort bool_sort = sf.CreateSort();
+  const Symbol::Sort obj_sort = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(bool_sort));
+  const Symbol P = sf.CreateFunction(bool_sort, 1);
+  const Symbol Q = sf.CreateFunction(bool_sort, 2);
+  const Symbol R = sf.CreateFunction(bool_sort, 1);
+  const Term x = tf.CreateTerm(sf.CreateVariable(obj_sort));
+  const Term y = tf.CreateTerm(sf.CreateVariable(obj_sort));
+  std::vector<Clause> units1;
+  std::vector<Clause> units2;
+  for (size_t i = 0; i < n_names; ++i) {
+    units1.push_back(Clause{Literal::Eq(tf.CreateTerm(P, {tf.CreateTerm(sf.CreateName(obj_sort))}), T)});
+    units2.push_back(Clause{Literal::Eq(tf.CreateTerm(R, {tf.CreateTerm(sf.CreateName(obj_sort))}), T)});
+  }
+  const Clause c{Literal::Neq(tf.CreateTerm(P, {x}), T),
+                 Literal::Eq(tf.CreateTerm(Q, {x, y}), T),
+                 Literal::Neq(tf.CreateTerm(R, {y}), T)};
+
+  for (size_t n_threads = 1; n_threads <= std::max(max_threads, size_t(1)); n_threads *= 2) {
+    Timer timer;
+    size_t n_clauses = 0;
+    for (size_t r = 0; r < n_rounds; ++r) {
+      Solver solver(&sf, &tf);
+      solver.grounder().set_n_threads(n_threads);
+      timer.start();
+      solver.grounder().AddClauses(units1.begin(), units1.end());
+      solver.grounder().AddClause(c);
+      solver.grounder().AddClauses(units2.begin(), units2.end());
+      timer.stop();
+      n_clauses = 0;
+      for (size_t i : solver.setup().clauses()) {
+        static_cast<void>(i);
+        ++n_clauses;
+      }
+    }
+    std::cout << n_threads << " threads: " << (timer.duration() / n_rounds) << " seconds per round, "
+              << n_clauses << " setup clauses" << std::endl;
+  }
+  return 0;
+}
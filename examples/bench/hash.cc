@@ -0,0 +1,237 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Compares the distribution of the XOR-based term and clause hashes with the
+// murmur3_combine() hashes on terms and clauses shaped like those of the
+// minesweeper and sudoku examples. For every set of distinct terms or clauses
+// it reports the number of colliding hashes, the longest chain in a
+// power-of-two table indexed by the low bits, the mean number of probes in an
+// open-addressing table like the Term::Factory's, and the time to fill an
+// unordered_set<Clause>.
+//
+// Usage: bench-hash [width [height [n-rounds]]]
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/literal.h>
+#include <limbo/term.h>
+
+#include <limbo/internal/hash.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Symbol;
+using limbo::Term;
+using limbo::internal::hash32_t;
+
+struct XorTermHash {
+  hash32_t operator()(Term t) const {
+    hash32_t h = t.symbol().hash();
+    for (Term arg : t.args()) {
+      h ^= arg.hash();
+    }
+    return h;
+  }
+};
+
+struct MurmurTermHash {
+  hash32_t operator()(Term t) const {
+    hash32_t h = t.symbol().hash();
+    for (Term arg : t.args()) {
+      h = limbo::internal::murmur3_combine(h, arg.index() << 1 | arg.name());
+    }
+    return limbo::internal::murmur3_finalize(h, t.arity());
+  }
+};
+
+struct XorClauseHash {
+  hash32_t operator()(const Clause& c) const {
+    hash32_t h = 0;
+    for (Literal a : c) {
+      h ^= limbo::internal::jenkins_hash(a.lhs().hash()) ^ limbo::internal::jenkins_hash(a.rhs().hash() + a.pos());
+    }
+    return h;
+  }
+};
+
+struct MurmurClauseHash {
+  hash32_t operator()(const Clause& c) const { return c.hash(); }
+};
+
+static void PrintStats(const std::string& name, const std::vector<hash32_t>& hashes) {
+  size_t size = 1;
+  while (size < 2 * hashes.size()) {
+    size *= 2;
+  }
+  std::vector<hash32_t> sorted = hashes;
+  std::sort(sorted.begin(), sorted.end());
+  const size_t n_distinct = std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+  std::vector<size_t> chains(size);
+  std::vector<bool> occupied(size);
+  size_t n_probes = 0;
+  for (hash32_t h : hashes) {
+    ++chains[h & (size - 1)];
+    size_t i = h & (size - 1);
+    for (++n_probes; occupied[i]; i = (i + 1) & (size - 1)) {
+      ++n_probes;
+    }
+    occupied[i] = true;
+  }
+  std::cout << std::setw(28) << std::left << name << std::right
+            << std::setw(8) << hashes.size() << " keys, "
+            << std::setw(8) << (hashes.size() - n_distinct) << " collisions, "
+            << "longest chain " << std::setw(4) << *std::max_element(chains.begin(), chains.end()) << ", "
+            << std::setprecision(3) << (static_cast<double>(n_probes) / hashes.size()) << " probes" << std::endl;
+}
+
+template<typename Hash, typename T>
+static std::vector<hash32_t> Hashes(const std::vector<T>& xs) {
+  std::vector<hash32_t> hs;
+  for (const T& x : xs) {
+    hs.push_back(Hash()(x));
+  }
+  return hs;
+}
+
+template<typename Hash>
+static double FillSet(const std::vector<Clause>& cs, size_t n_rounds) {
+  Timer timer;
+  timer.start();
+  for (size_t r = 0; r < n_rounds; ++r) {
+    std::unordered_set<Clause, Hash> set;
+    for (const Clause& c : cs) {
+      set.insert(c);
+    }
+    for (const Clause& c : cs) {
+      if (set.count(c) != 1) {
+        std::cerr << "missing clause" << std::endl;
+      }
+    }
+  }
+  timer.stop();
+  return timer.duration();
+}
+
+static void Report(const std::string& name, const std::vector<Term>& ts, std::vector<Clause> cs, size_t n_rounds) {
+  const std::unordered_set<Clause> distinct(cs.begin(), cs.end());
+  cs.assign(distinct.begin(), distinct.end());
+  PrintStats(name + " terms xor", Hashes<XorTermHash>(ts));
+  PrintStats(name + " terms murmur3", Hashes<MurmurTermHash>(ts));
+  PrintStats(name + " clauses xor", Hashes<XorClauseHash>(cs));
+  PrintStats(name + " clauses murmur3", Hashes<MurmurClauseHash>(cs));
+  std::cout << std::setw(28) << std::left << (name + " unordered_set") << std::right
+            << " xor " << FillSet<XorClauseHash>(cs, n_rounds) << " seconds, "
+            << "murmur3 " << FillSet<MurmurClauseHash>(cs, n_rounds) << " seconds" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t width = 30;
+  size_t height = 16;
+  size_t n_rounds = 10;
+  if (argc >= 2) {
+    width = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    height = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+
+  {
+    // Minesweeper: Mine(x,y) = T for names x and y of different sorts, and for
+    // every cell the clauses that say that not all pairs of neighbours are
+    // mines, or not all are safe.
+    const Symbol::Sort bool_sort = sf.CreateSort();
+    const Symbol::Sort x_sort = sf.CreateSort();
+    const Symbol::Sort y_sort = sf.CreateSort();
+    const Term T = tf.CreateTerm(sf.CreateName(bool_sort));
+    const Symbol mine = sf.CreateFunction(bool_sort, 2);
+    std::vector<Term> xs;
+    std::vector<Term> ys;
+    for (size_t i = 0; i < width; ++i) {
+      xs.push_back(tf.CreateTerm(sf.CreateName(x_sort)));
+    }
+    for (size_t j = 0; j < height; ++j) {
+      ys.push_back(tf.CreateTerm(sf.CreateName(y_sort)));
+    }
+    std::vector<Term> ts;
+    for (size_t i = 0; i < width; ++i) {
+      for (size_t j = 0; j < height; ++j) {
+        ts.push_back(tf.CreateTerm(mine, {xs[i], ys[j]}));
+      }
+    }
+    std::vector<Clause> cs;
+    for (size_t i = 0; i < width; ++i) {
+      for (size_t j = 0; j < height; ++j) {
+        std::vector<Term> ns;
+        for (size_t ii = i > 0 ? i - 1 : i; ii <= i + 1 && ii < width; ++ii) {
+          for (size_t jj = j > 0 ? j - 1 : j; jj <= j + 1 && jj < height; ++jj) {
+            if (ii != i || jj != j) {
+              ns.push_back(ts[ii * height + jj]);
+            }
+          }
+        }
+        for (size_t k = 0; k < ns.size(); ++k) {
+          for (size_t l = k + 1; l < ns.size(); ++l) {
+            cs.push_back(Clause{Literal::Neq(ns[k], T), Literal::Neq(ns[l], T)});
+            cs.push_back(Clause{Literal::Eq(ns[k], T), Literal::Eq(ns[l], T)});
+          }
+        }
+      }
+    }
+    Report("minesweeper", ts, cs, n_rounds);
+  }
+
+  {
+    // Sudoku: val(x,y) = v where x, y, and v are names of the same sort, the
+    // clauses val(x,y) = 1 v ... v val(x,y) = n for every cell, and the clauses
+    // val(x,y) /= val(x',y') for cells in the same row or column.
+    const size_t n = std::max(width, height);
+    const Symbol::Sort sort = sf.CreateSort();
+    const Symbol val = sf.CreateFunction(sort, 2);
+    std::vector<Term> vs;
+    for (size_t i = 0; i < n; ++i) {
+      vs.push_back(tf.CreateTerm(sf.CreateName(sort)));
+    }
+    std::vector<Term> ts;
+    std::vector<Clause> cs;
+    for (size_t x = 0; x < n; ++x) {
+      for (size_t y = 0; y < n; ++y) {
+        ts.push_back(tf.CreateTerm(val, {vs[x], vs[y]}));
+      }
+    }
+    for (size_t x = 0; x < n; ++x) {
+      for (size_t y = 0; y < n; ++y) {
+        std::vector<Literal> lits;
+        for (Term v : vs) {
+          lits.push_back(Literal::Eq(ts[x * n + y], v));
+        }
+        cs.push_back(Clause(lits.begin(), lits.end()));
+        for (size_t z = 0; z < n; ++z) {
+          if (z != y) {
+            cs.push_back(Clause{Literal::Neq(ts[x * n + y], ts[x * n + z])});
+          }
+          if (z != x) {
+            cs.push_back(Clause{Literal::Neq(ts[x * n + y], ts[z * n + y])});
+          }
+        }
+      }
+    }
+    Report("sudoku", ts, cs, n_rounds);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Stress test of concurrent term creation: every thread creates the same
+// n-names^2 terms f(n1,n2) in its own order, so that the threads race to
+// intern them and afterwards mostly find existing terms. Checks that all
+// threads obtain the same terms and reports the throughput for 1, 2, 4, ...
+// threads.
+//
+// Usage: bench-intern [max-threads [n-names [n-rounds]]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t max_threads = std::thread::hardware_concurrency();
+  size_t n_names = 300;
+  size_t n_rounds = 10;
+  if (argc >= 2) {
+    max_threads = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_names = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  std::vector<Term> names;
+  for (size_t i = 0; i < n_names; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+
+  for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    const Symbol f = sf.CreateFunction(sort, 2);
+    std::vector<std::vector<Term>> terms(n_threads, std::vector<Term>(n_names * n_names));
+    Timer timer;
+    timer.start();
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < n_threads; ++k) {
+      threads.emplace_back([&, k]() {
+        for (size_t r = 0; r < n_rounds; ++r) {
+          for (size_t i = 0; i < n_names; ++i) {
+            const size_t ii = (i + k * n_names / n_threads) % n_names;
+            for (size_t j = 0; j < n_names; ++j) {
+              const Term args[] = {names[ii], names[j]};
+              terms[k][ii * n_names + j] = tf.CreateTerm(f, args, args + 2);
+            }
+          }
+        }
+      });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    timer.stop();
+    bool consistent = true;
+    for (size_t k = 1; k < n_threads; ++k) {
+      consistent &= terms[k] == terms[0];
+    }
+    const double n = static_cast<double>(n_threads * n_rounds * n_names * n_names);
+    std::cout << n_threads << " threads: " << (n / timer.duration() / 1e6) << " M terms/s, "
+              << timer.duration() << " seconds" << (consistent ? "" : ", INCONSISTENT") << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Compares eager grounding with the lazy mode of Grounder::set_lazy() on a
+// knowledge base of n-names names with facts Edge(n_i,n_i+1) = T and a rule
+// Edge(x,y) /= T v Near(x,y) = T, which is grounded for all n-names^2 pairs
+// in eager mode. Then n-queries queries Near(n_i,n_j) = T are evaluated with
+// consistency guarantee. Reports the time and the number of generated clauses
+// for the knowledge base and per query; the answers must be the same.
+//
+// Usage: bench-lazy [n-names [n-queries [seed]]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/formula.h>
+#include <limbo/grounder.h>
+#include <limbo/literal.h>
+#include <limbo/solver.h>
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Formula;
+using limbo::Literal;
+using limbo::Solver;
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t n_names = 100;
+  size_t n_queries = 100;
+  size_t seed = 0;
+  if (argc >= 2) {
+    n_names = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_queries = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    seed = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort bool_sort = sf.CreateSort();
+  const Symbol::Sort obj_sort = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(bool_sort));
+  const Symbol Edge = sf.CreateFunction(bool_sort, 2);
+  const Symbol Near = sf.CreateFunction(bool_sort, 2);
+  const Term x = tf.CreateTerm(sf.CreateVariable(obj_sort));
+  const Term y = tf.CreateTerm(sf.CreateVariable(obj_sort));
+  std::vector<Term> names;
+  for (size_t i = 0; i < n_names; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(obj_sort)));
+  }
+  std::vector<Clause> kb;
+  for (size_t i = 0; i + 1 < n_names; ++i) {
+    kb.push_back(Clause{Literal::Eq(tf.CreateTerm(Edge, {names[i], names[i+1]}), T)});
+  }
+  kb.push_back(Clause{Literal::Neq(tf.CreateTerm(Edge, {x, y}), T), Literal::Eq(tf.CreateTerm(Near, {x, y}), T)});
+
+  std::mt19937 gen(seed);
+  std::vector<Formula::Ref> queries;
+  for (size_t q = 0; q < n_queries; ++q) {
+    const size_t i = gen() % n_names;
+    const size_t j = q % 2 == 0 && i + 1 < n_names ? i + 1 : gen() % n_names;
+    queries.push_back(Formula::Factory::Atomic(Clause{Literal::Eq(tf.CreateTerm(Near, {names[i], names[j]}), T)}));
+  }
+
+  std::vector<bool> answers[2];
+  for (bool lazy : {false, true}) {
+    Solver solver(&sf, &tf);
+    solver.grounder().set_lazy(lazy);
+    Timer kb_timer;
+    kb_timer.start();
+    solver.grounder().AddClauses(kb.begin(), kb.end());
+    kb_timer.stop();
+    const size_t n_kb_clauses = solver.grounder().n_generated_clauses();
+    Timer query_timer;
+    query_timer.start();
+    for (const Formula::Ref& phi : queries) {
+      answers[lazy].push_back(solver.Entails(1, *phi, Solver::kConsistencyGuarantee));
+    }
+    query_timer.stop();
+    const size_t n_query_clauses = solver.grounder().n_generated_clauses() - n_kb_clauses;
+    std::cout << (lazy ? "lazy:  " : "eager: ")
+              << "knowledge base " << kb_timer.duration() << " seconds, " << n_kb_clauses << " clauses; "
+              << "queries " << (query_timer.duration() / n_queries) << " seconds, "
+              << (static_cast<double>(n_query_clauses) / n_queries) << " clauses per query" << std::endl;
+  }
+  size_t n_true = 0;
+  for (bool b : answers[0]) {
+    n_true += b;
+  }
+  std::cout << n_true << " of " << n_queries << " queries entailed"
+            << (answers[0] == answers[1] ? "" : ", DIFFERENT ANSWERS") << std::endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Compares sequential and parallel Setup::Minimize() on a random setup whose
+// clauses often subsume each other.
+//
+// Usage: bench-minimize [n-clauses [n-threads [seed]]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/literal.h>
+#include <limbo/setup.h>
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Setup;
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t n_clauses = 20000;
+  size_t n_threads = std::thread::hardware_concurrency();
+  size_t seed = 0;
+  if (argc >= 2) {
+    n_clauses = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_threads = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    seed = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  std::vector<Term> names;
+  for (size_t i = 0; i < 8; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+  std::vector<Term> funcs;
+  for (size_t i = 0; i < n_clauses / 20 + 1; ++i) {
+    const Symbol f = sf.CreateFunction(sort, 1);
+    for (const Term n : names) {
+      funcs.push_back(tf.CreateTerm(f, {n}));
+    }
+  }
+
+  // Every clause extends an earlier one with probability 1/2, so that many
+  // clauses are subsumed.
+  std::mt19937 gen(seed);
+  auto random_literal = [&]() {
+    const Term t = funcs[gen() % funcs.size()];
+    const Term n = names[gen() % names.size()];
+    return gen() % 2 == 0 ? Literal::Eq(t, n) : Literal::Neq(t, n);
+  };
+  std::vector<std::vector<Literal>> clauses;
+  for (size_t i = 0; i < n_clauses; ++i) {
+    std::vector<Literal> c;
+    if (!clauses.empty() && gen() % 2 == 0) {
+      c = clauses[gen() % clauses.size()];
+    }
+    for (size_t k = 2 + gen() % 2; k > 0; --k) {
+      c.push_back(random_literal());
+    }
+    clauses.push_back(c);
+  }
+
+  Setup s1;
+  Setup sn;
+  for (const std::vector<Literal>& lits : clauses) {
+    const Clause c(lits.begin(), lits.end());
+    if (!c.valid()) {
+      s1.AddClause(c);
+      sn.AddClause(c);
+    }
+  }
+
+  Timer t1;
+  t1.start();
+  s1.Minimize(1);
+  t1.stop();
+
+  Timer tn;
+  tn.start();
+  sn.Minimize(n_threads);
+  tn.stop();
+
+  bool same = std::distance(s1.clauses().begin(), s1.clauses().end()) ==
+              std::distance(sn.clauses().begin(), sn.clauses().end());
+  for (auto it = s1.clauses().begin(), jt = sn.clauses().begin(); same && it != s1.clauses().end(); ++it, ++jt) {
+    same = s1.clause(*it) == sn.clause(*jt);
+  }
+
+  std::cout << "clauses: " << clauses.size() << " -> " << std::distance(s1.clauses().begin(), s1.clauses().end())
+            << std::endl;
+  std::cout << "sequential: " << t1.duration() << " seconds" << std::endl;
+  std::cout << "parallel (" << n_threads << " threads): " << tn.duration() << " seconds" << std::endl;
+  std::cout << "results " << (same ? "agree" : "DIFFER") << std::endl;
+  return same ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Compares the instantiation of a compiled Grounder::Plan with Substitute() on
+// clauses like those of the battleship example, where a single variable
+// occurs in deeply nested terms, and on a clause with two variables, where
+// the plan creates the terms of the outer variable once per name. The plan
+// is run with and without a Term::SubstitutionMemo.
+//
+// Usage: bench-plan [n-names [n-rounds]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/grounder.h>
+#include <limbo/literal.h>
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Grounder;
+using limbo::Literal;
+using limbo::Symbol;
+using limbo::Term;
+
+static void Compare(const std::string& name, const Clause& c, const std::vector<Term>& names, size_t n_rounds) {
+  Term::Factory* tf = Term::Factory::Instance();
+  const Grounder::Plan<Clause> plan(c);
+  const Term::Vector& vars = plan.vars();
+
+  Timer substitute;
+  size_t n_groundings = 0;
+  size_t checksum1 = 0;
+  substitute.start();
+  for (size_t r = 0; r < n_rounds; ++r) {
+    std::vector<size_t> indices(vars.size(), 0);
+    for (bool more = true; more; ) {
+      const Clause g = c.Substitute([&](Term x) -> limbo::internal::Maybe<Term> {
+        for (size_t i = 0; i < vars.size(); ++i) {
+          if (x == vars[i]) {
+            return limbo::internal::Just(names[indices[i]]);
+          }
+        }
+        return limbo::internal::Nothing;
+      }, tf);
+      checksum1 += g.hash();
+      ++n_groundings;
+      more = false;
+      for (size_t i = vars.size(); i > 0 && !more; --i) {
+        more = ++indices[i - 1] < names.size();
+        if (!more) {
+          indices[i - 1] = 0;
+        }
+      }
+    }
+  }
+  substitute.stop();
+
+  Timer instantiate;
+  size_t checksum2 = 0;
+  instantiate.start();
+  for (size_t r = 0; r < n_rounds; ++r) {
+    plan.Ground(tf, [&names](size_t) -> const Term::Vector& { return names; }, [&checksum2](const Clause& g) {
+      checksum2 += g.hash();
+      return true;
+    });
+  }
+  instantiate.stop();
+
+  Term::SubstitutionMemo memo;
+  Timer memoized;
+  size_t checksum3 = 0;
+  memoized.start();
+  for (size_t r = 0; r < n_rounds; ++r) {
+    plan.Ground(tf, [&names](size_t) -> const Term::Vector& { return names; }, [&checksum3](const Clause& g) {
+      checksum3 += g.hash();
+      return true;
+    }, &memo);
+  }
+  memoized.stop();
+
+  const double n = static_cast<double>(n_groundings);
+  std::cout << name << ": Substitute(): " << (n / substitute.duration() / 1e6) << " M clauses/s, "
+            << "Plan: " << (n / instantiate.duration() / 1e6) << " M clauses/s, "
+            << "memoized: " << (n / memoized.duration() / 1e6) << " M clauses/s "
+            << "(" << memo.n_hits() << " hits, " << memo.n_misses() << " misses)"
+            << (checksum1 == checksum2 && checksum1 == checksum3 ? "" : ", MISMATCH") << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_names = 100;
+  size_t n_rounds = 10;
+  if (argc >= 2) {
+    n_names = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    n_rounds = atoi(argv[2]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort bool_sort = sf.CreateSort();
+  const Symbol::Sort sort = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(bool_sort));
+  std::vector<Term> names;
+  for (size_t i = 0; i < n_names; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+  const Term x = tf.CreateTerm(sf.CreateVariable(sort));
+  const Term y = tf.CreateTerm(sf.CreateVariable(sort));
+
+  {
+    // hori(s) = T ^ s /= two ^ s /= three -> water(ea(ea(ea(xpos(s)))), so(ypos(s))) /= T
+    const Symbol hori = sf.CreateFunction(bool_sort, 1);
+    const Symbol water = sf.CreateFunction(bool_sort, 2);
+    const Symbol xpos = sf.CreateFunction(sort, 1);
+    const Symbol ypos = sf.CreateFunction(sort, 1);
+    const Symbol ea = sf.CreateFunction(sort, 1);
+    const Symbol so = sf.CreateFunction(sort, 1);
+    Term t = tf.CreateTerm(xpos, {x});
+    for (size_t i = 0; i < 3; ++i) {
+      t = tf.CreateTerm(ea, {t});
+    }
+    const Clause c{Literal::Neq(tf.CreateTerm(hori, {x}), T),
+                   Literal::Eq(x, names[0]),
+                   Literal::Eq(x, names[1]),
+                   Literal::Neq(tf.CreateTerm(water, {t, tf.CreateTerm(so, {tf.CreateTerm(ypos, {x})})}), T)};
+    Compare("battleship", c, names, n_rounds * n_names);
+  }
+
+  {
+    // P(f(x)) /= T v Q(f(x),g(y)) = T v R(g(y)) /= T
+    const Symbol P = sf.CreateFunction(bool_sort, 1);
+    const Symbol Q = sf.CreateFunction(bool_sort, 2);
+    const Symbol R = sf.CreateFunction(bool_sort, 1);
+    const Term fx = tf.CreateTerm(sf.CreateFunction(sort, 1), {x});
+    const Term gy = tf.CreateTerm(sf.CreateFunction(sort, 1), {y});
+    const Clause c{Literal::Neq(tf.CreateTerm(P, {fx}), T),
+                   Literal::Eq(tf.CreateTerm(Q, {fx, gy}), T),
+                   Literal::Neq(tf.CreateTerm(R, {gy}), T)};
+    Compare("two variables", c, names, n_rounds);
+  }
+  return 0;
+}
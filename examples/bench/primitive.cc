@@ -0,0 +1,67 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Measures Clause::primitive() and Clause::ground() on large clauses, which
+// spend their time in the Term attribute tests.
+//
+// Usage: bench-primitive [clause-size [arity [n-rounds]]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t clause_size = 1000;
+  size_t arity = 2;
+  size_t n_rounds = 10000;
+  if (argc >= 2) {
+    clause_size = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    arity = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  const Term n = tf.CreateTerm(sf.CreateName(sort));
+  std::vector<Literal> lits;
+  for (size_t i = 0; i < clause_size; ++i) {
+    const Symbol f = sf.CreateFunction(sort, arity);
+    const Term t = tf.CreateTerm(f, Term::Vector(arity, tf.CreateTerm(sf.CreateName(sort))));
+    lits.push_back(i % 2 == 0 ? Literal::Eq(t, n) : Literal::Neq(t, n));
+  }
+  const Clause c(lits.begin(), lits.end());
+
+  Timer primitive;
+  Timer ground;
+  size_t n_true = 0;
+  for (size_t r = 0; r < n_rounds; ++r) {
+    primitive.start();
+    n_true += c.primitive();
+    primitive.stop();
+    ground.start();
+    n_true += c.ground();
+    ground.stop();
+  }
+
+  const double n_lits = static_cast<double>(n_rounds * c.size());
+  std::cout << "primitive(): " << (n_lits / primitive.duration() / 1e6) << " M literals/s, "
+            << "ground(): " << (n_lits / ground.duration() / 1e6) << " M literals/s "
+            << "(" << n_true << " true)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,139 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Compares the scalar test whether two watched literals subsume a clause,
+// Clause::Subsumes(a, b, d), with the batch kernels of Literal::SubsumesAny()
+// as used by Setup::Subsumes().
+//
+// Usage: bench-subsume [n-candidates [query-size [rounds [seed]]]]
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/literal.h>
+#include <limbo/term.h>
+
+#include <limbo/internal/simd.h>
+
+#include "timer.h"
+
+using limbo::Clause;
+using limbo::Literal;
+using limbo::Symbol;
+using limbo::Term;
+
+namespace internal = limbo::internal;
+
+int main(int argc, char *argv[]) {
+  size_t n_candidates = 4096;
+  size_t query_size = 6;
+  size_t rounds = 2000;
+  size_t seed = 0;
+  if (argc >= 2) {
+    n_candidates = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    query_size = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    rounds = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    seed = atoi(argv[4]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  std::vector<Term> names;
+  for (size_t i = 0; i < 4; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+  std::vector<Term> funcs;
+  for (size_t i = 0; i < 2 * query_size; ++i) {
+    funcs.push_back(tf.CreateTerm(sf.CreateFunction(sort, 0), {}));
+  }
+  std::mt19937 gen(seed);
+  auto random_literal = [&]() {
+    const Term t = funcs[gen() % funcs.size()];
+    const Term n = names[gen() % names.size()];
+    return gen() % 2 == 0 ? Literal::Eq(t, n) : Literal::Neq(t, n);
+  };
+
+  std::vector<Literal> query;
+  for (size_t i = 0; i < query_size; ++i) {
+    query.push_back(random_literal());
+  }
+  const Clause d(query.begin(), query.end());
+  query.assign(d.begin(), d.end());
+  std::vector<Literal> as;
+  std::vector<Literal> bs;
+  for (size_t i = 0; i < n_candidates; ++i) {
+    Literal a = random_literal();
+    Literal b = random_literal();
+    while (!(a < b)) {
+      a = random_literal();
+      b = random_literal();
+    }
+    as.push_back(a);
+    bs.push_back(b);
+  }
+
+  size_t expected = 0;
+  Timer scalar_timer;
+  scalar_timer.start();
+  for (size_t r = 0; r < rounds; ++r) {
+    expected = 0;
+    for (size_t i = 0; i < n_candidates; ++i) {
+      expected += Clause::Subsumes(as[i], bs[i], d);
+    }
+  }
+  scalar_timer.stop();
+  std::cout << "Clause::Subsumes(a, b, d): " << scalar_timer.duration() << " seconds, " << expected << " hits"
+            << std::endl;
+
+  std::vector<std::pair<std::string, internal::SubsumesAnyFunction>> kernels = {{"scalar", internal::SubsumesAnyScalar}};
+#ifdef LIMBO_SIMD_X86
+  if (__builtin_cpu_supports("sse4.1")) {
+    kernels.push_back(std::make_pair("sse4.1", internal::SubsumesAnySse41));
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back(std::make_pair("avx2", internal::SubsumesAnyAvx2));
+  }
+#endif
+  const size_t kBatchSize = 16;
+  const auto* qs = reinterpret_cast<const internal::u64*>(query.data());
+  const auto* as_bits = reinterpret_cast<const internal::u64*>(as.data());
+  const auto* bs_bits = reinterpret_cast<const internal::u64*>(bs.data());
+  bool ok = true;
+  for (const auto& kernel : kernels) {
+    bool a_out[kBatchSize];
+    bool b_out[kBatchSize];
+    size_t hits = 0;
+    Timer timer;
+    timer.start();
+    for (size_t r = 0; r < rounds; ++r) {
+      hits = 0;
+      for (size_t i = 0; i < n_candidates; i += kBatchSize) {
+        const size_t m = std::min(kBatchSize, n_candidates - i);
+        kernel.second(as_bits + i, m, qs, query.size(), a_out);
+        kernel.second(bs_bits + i, m, qs, query.size(), b_out);
+        for (size_t k = 0; k < m; ++k) {
+          hits += a_out[k] && b_out[k];
+        }
+      }
+    }
+    timer.stop();
+    std::cout << "SubsumesAny (" << kernel.first << "): " << timer.duration() << " seconds, " << hits << " hits"
+              << std::endl;
+    ok &= hits == expected;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Measures the throughput of ground term creation as it happens in grounding:
+// most calls of CreateTerm() and Substitute() yield a term that exists
+// already. Substitute() is run with and without a Term::SubstitutionMemo.
+//
+// Usage: bench-term [n-names [arity [n-rounds [seed]]]]
+
+#include <cstdlib>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <limbo/term.h>
+
+#include "timer.h"
+
+using limbo::Symbol;
+using limbo::Term;
+
+int main(int argc, char *argv[]) {
+  size_t n_names = 30;
+  size_t arity = 2;
+  size_t n_rounds = 20;
+  size_t seed = 0;
+  if (argc >= 2) {
+    n_names = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    arity = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    n_rounds = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    seed = atoi(argv[4]);
+  }
+
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort sort = sf.CreateSort();
+  const Symbol f = sf.CreateFunction(sort, arity);
+  std::vector<Term> names;
+  std::vector<Term> vars;
+  for (size_t i = 0; i < n_names; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+  for (size_t i = 0; i < arity; ++i) {
+    vars.push_back(tf.CreateTerm(sf.CreateVariable(sort)));
+  }
+  const Term pattern = tf.CreateTerm(f, vars);
+
+  std::mt19937 gen(seed);
+  std::vector<std::vector<Term>> args(100000, std::vector<Term>(arity));
+  for (std::vector<Term>& a : args) {
+    for (Term& t : a) {
+      t = names[gen() % names.size()];
+    }
+  }
+
+  auto theta = [&vars](const std::vector<Term>& a) {
+    return [&vars, &a](Term x) -> limbo::internal::Maybe<Term> {
+      for (size_t i = 0; i < vars.size(); ++i) {
+        if (x == vars[i]) {
+          return limbo::internal::Just(a[i]);
+        }
+      }
+      return limbo::internal::Nothing;
+    };
+  };
+
+  Term::SubstitutionMemo memo;
+  Timer create;
+  Timer substitute;
+  Timer memoized;
+  size_t checksum = 0;
+  for (size_t r = 0; r < n_rounds; ++r) {
+    create.start();
+    for (const std::vector<Term>& a : args) {
+      checksum += tf.CreateTerm(f, a).index();
+    }
+    create.stop();
+    substitute.start();
+    for (const std::vector<Term>& a : args) {
+      checksum += pattern.Substitute(theta(a), &tf).index();
+    }
+    substitute.stop();
+    memoized.start();
+    for (const std::vector<Term>& a : args) {
+      checksum += pattern.Substitute(memo.Memoize(theta(a), &tf), &tf).index();
+    }
+    memoized.stop();
+  }
+
+  const double n = static_cast<double>(n_rounds * args.size());
+  std::cout << "CreateTerm: " << (n / create.duration() / 1e6) << " M/s, "
+            << "Substitute: " << (n / substitute.duration() / 1e6) << " M/s, "
+            << "memoized: " << (n / memoized.duration() / 1e6) << " M/s "
+            << "(" << memo.n_hits() << " hits, " << memo.n_misses() << " misses, checksum " << checksum << ")"
+            << std::endl;
+  return 0;
+}
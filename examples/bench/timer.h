@@ -0,0 +1,35 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+//
+// Measures wall-clock time, which unlike CPU time is meaningful for code that
+// runs in several threads.
+
+#ifndef EXAMPLES_BENCH_TIMER_H_
+#define EXAMPLES_BENCH_TIMER_H_
+
+#include <chrono>
+
+class Timer {
+ public:
+  Timer() : start_(Clock::now()) {}
+
+  void start() {
+    start_ = Clock::now() - (end_ - start_);
+    ++rounds_;
+  }
+  void stop() { end_ = Clock::now(); }
+  void reset() { start_ = end_ = Clock::time_point(); rounds_ = 0; }
+
+  double duration() const { return std::chrono::duration<double>(end_ - start_).count(); }
+  size_t rounds() const { return rounds_; }
+  double avg_duration() const { return duration() / rounds_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::time_point start_;
+  Clock::time_point end_ = start_;
+  size_t rounds_ = 0;
+};
+
+#endif  // EXAMPLES_BENCH_TIMER_H_
@@ -267,7 +267,7 @@ class KnowledgeBase {
   size_t max_k_;
 
   std::vector<limbo::Clause> clauses_;
-  size_t n_processed_clauses_;
+  size_t n_processed_clauses_ = 0;
 
   limbo::Solver solver_;
 
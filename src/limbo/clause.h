@@ -16,6 +16,10 @@
 // storing these values in Bloom filters, we can (hopefully often) detect early
 // that unit propagation or subsumption won't work early (in a sound but
 // incomplete way).
+//
+// The first LIMBO_CLAUSE_INLINE_SIZE literals are stored in the clause object
+// itself, the remaining ones in an array from Pool<Literal>. The Pool's
+// PoolStats record the clause sizes, which may help to choose the inline size.
 
 #ifndef LIMBO_CLAUSE_H_
 #define LIMBO_CLAUSE_H_
@@ -34,11 +38,17 @@
 #include <limbo/literal.h>
 
 #include <limbo/internal/bloom.h>
+#include <limbo/internal/hash.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/iter.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/pool.h>
 #include <limbo/internal/traits.h>
 
+#ifndef LIMBO_CLAUSE_INLINE_SIZE
+#define LIMBO_CLAUSE_INLINE_SIZE 5
+#endif
+
 namespace limbo {
 
 class Clause {
@@ -53,6 +63,7 @@ class Clause {
 #ifdef BLOOM
     InitBloom();
 #endif
+    internal::PoolStats::RecordSize(size_);
   }
 
   Clause(std::initializer_list<Literal> lits) : Clause(lits.size(), lits.begin(), lits.end()) {}
@@ -73,12 +84,13 @@ class Clause {
 #ifdef BLOOM
     InitBloom();
 #endif
+    internal::PoolStats::RecordSize(size_);
   }
 
   Clause(const Clause& c) : Clause(c.size_) {
     std::memcpy(lits1_, c.lits1_, size1() * sizeof(Literal));
     if (size2() > 0) {
-      std::memcpy(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal));
+      std::memcpy(lits2_, c.lits2_, size2() * sizeof(Literal));
     }
 #ifdef BLOOM
     lhs_bloom_ = c.lhs_bloom_;
@@ -88,14 +100,17 @@ class Clause {
   }
 
   Clause& operator=(const Clause& c) {
-    const size_t old_size = c.size_;
+    if (this == &c) {
+      return *this;
+    }
+    if (capacity2_ < c.size2()) {
+      Release();
+      Allocate(c.size2());
+    }
     size_ = c.size_;
     std::memcpy(lits1_, c.lits1_, size1() * sizeof(Literal));
-    if (size_ > kArraySize) {
-      if (size_ > old_size) {
-        lits2_ = std::unique_ptr<Literal[]>(new Literal[size2()]);
-      }
-      std::memcpy(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal));
+    if (size2() > 0) {
+      std::memcpy(lits2_, c.lits2_, size2() * sizeof(Literal));
     }
 #ifdef BLOOM
     lhs_bloom_ = c.lhs_bloom_;
@@ -104,8 +119,28 @@ class Clause {
     return *this;
   }
 
-  Clause(Clause&&) = default;
-  Clause& operator=(Clause&&) = default;
+  Clause(Clause&& c) { *this = std::move(c); }
+
+  Clause& operator=(Clause&& c) {
+    if (this == &c) {
+      return *this;
+    }
+    Release();
+    size_ = c.size_;
+    capacity2_ = c.capacity2_;
+    lits2_ = c.lits2_;
+    std::memcpy(lits1_, c.lits1_, size1() * sizeof(Literal));
+#ifdef BLOOM
+    lhs_bloom_ = c.lhs_bloom_;
+    c.lhs_bloom_.Clear();
+#endif
+    c.size_ = 0;
+    c.capacity2_ = 0;
+    c.lits2_ = nullptr;
+    return *this;
+  }
+
+  ~Clause() { Release(); }
 
   bool operator==(const Clause& c) const {
     return size() == c.size() &&
@@ -113,16 +148,16 @@ class Clause {
            lhs_bloom_ == c.lhs_bloom_ &&
 #endif
            std::memcmp(lits1_, c.lits1_, size1() * sizeof(Literal)) == 0 &&
-           (size2() == 0 || std::memcmp(lits2_.get(), c.lits2_.get(), size2() * sizeof(Literal)) == 0);
+           (size2() == 0 || std::memcmp(lits2_, c.lits2_, size2() * sizeof(Literal)) == 0);
   }
   bool operator!=(const Clause& c) const { return !(*this == c); }
 
   internal::hash32_t hash() const {
     internal::hash32_t h = 0;
     for (size_t i = 0; i < size(); ++i) {
-      h ^= (*this)[i].hash();
+      h = internal::murmur3_combine(h, (*this)[i].hash());
     }
-    return h;
+    return internal::murmur3_finalize(h, size());
   }
 
   const_iterator cbegin() const { return const_iterator(this, 0); }
@@ -171,6 +206,7 @@ class Clause {
     if (!c.lhs_bloom_.PossiblyContains(a.lhs())) {
       return false;
     }
+    internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return c.MentionsLhsExactly(a.lhs()); });
 #endif
     size_t i = 0;
     for (; i < c.size() && a.lhs() > c[i].lhs(); ++i) {
@@ -190,6 +226,8 @@ class Clause {
     if (!c.lhs_bloom_.PossiblyContains(a.lhs()) || !c.lhs_bloom_.PossiblyContains(b.lhs())) {
       return false;
     }
+    internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return c.MentionsLhsExactly(a.lhs()); });
+    internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return c.MentionsLhsExactly(b.lhs()); });
 #endif
     size_t i = 0;
     for (; i < c.size() && a.lhs() > c[i].lhs(); ++i) {
@@ -218,6 +256,9 @@ next:
     if (!c.lhs_bloom_.PossiblySubsetOf(d.lhs_bloom_)) {
       return false;
     }
+    internal::BloomStats::Record(internal::BloomStats::kSubsetOf, [&]() {
+      return c.all([&d](const Literal a) { return d.MentionsLhsExactly(a.lhs()); });
+    });
 #endif
     size_t i = 0;
     size_t j = 0;
@@ -249,6 +290,7 @@ next:
     if (!lhs_bloom_.PossiblyContains(b.lhs())) {
       return;
     }
+    internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return MentionsLhsExactly(b.lhs()); });
 #endif
     for (size_t i = 0; i < size(); ++i) {
       const Literal a = (*this)[i];
@@ -318,6 +360,7 @@ next:
       if (!lhs_bloom_.PossiblyContains(b.lhs())) {
         continue;
       }
+      internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return MentionsLhsExactly(b.lhs()); });
 #endif
       for (size_t i = 0; i < size(); ++i) {
         const Literal a = (*this)[i];
@@ -332,24 +375,48 @@ next:
 #endif
   }
 
+  // PropagateUnitsIf() removes every literal a for which complementary(a)
+  // holds, that is, for units stored in a custom structure.
+  template<typename UnaryPredicate>
+  void PropagateUnitsIf(UnaryPredicate complementary) {
+    assert(primitive());
+    assert(!valid());
+    for (size_t i = 0; i < size(); ++i) {
+      if (complementary((*this)[i])) {
+        Nullify(i);
+      }
+    }
+    RemoveNulls();
+#ifdef BLOOM
+    InitBloom();
+#endif
+  }
+
   bool ground()         const { return all([](Literal a) { return a.ground(); }); }
   bool primitive()      const { return all([](Literal a) { return a.primitive(); }); }
   bool quasiprimitive() const { return all([](Literal a) { return a.quasiprimitive(); }); }
 
   bool Mentions(Literal a) const {
-    return
 #ifdef BLOOM
-        lhs_bloom_.PossiblyContains(a.lhs()) &&
+    if (!lhs_bloom_.PossiblyContains(a.lhs())) {
+      return false;
+    }
+    internal::BloomStats::Record(internal::BloomStats::kContains, [&]() { return MentionsLhsExactly(a.lhs()); });
 #endif
-        any([a](Literal b) { return a == b; });
+    return any([a](Literal b) { return a == b; });
   }
 
   bool MentionsLhs(Term t) const {
-    return
 #ifdef BLOOM
-        lhs_bloom_.PossiblyContains(t) &&
+    if (!lhs_bloom_.PossiblyContains(t)) {
+      return false;
+    }
+    const bool r = MentionsLhsExactly(t);
+    internal::BloomStats::Record(internal::BloomStats::kContains, [r]() { return r; });
+    return r;
+#else
+    return MentionsLhsExactly(t);
 #endif
-        any([t](Literal a) { return a.lhs() == t; });
   }
 
   template<typename UnaryPredicate>
@@ -395,11 +462,27 @@ next:
  private:
   friend class internal::array_iterator<Clause, Literal>;
   typedef internal::array_iterator<Clause, Literal> iterator;
-  static constexpr size_t kArraySize = 5;
+  typedef internal::Pool<Literal> Pool;
+  static constexpr size_t kArraySize = LIMBO_CLAUSE_INLINE_SIZE;
+  static_assert(kArraySize >= 1, "Clause must store at least one literal inline");
 
   explicit Clause(size_t size) : size_(size) {
     if (size2() > 0) {
-      lits2_ = std::unique_ptr<Literal[]>(new Literal[size2()]);
+      Allocate(size2());
+    }
+  }
+
+  void Allocate(size_t n) {
+    assert(!lits2_);
+    capacity2_ = Pool::Capacity(n);
+    lits2_ = Pool::Allocate(capacity2_);
+  }
+
+  void Release() {
+    if (lits2_) {
+      Pool::Release(lits2_, capacity2_);
+      lits2_ = nullptr;
+      capacity2_ = 0;
     }
   }
 
@@ -432,6 +515,8 @@ next:
     assert(!any([](Literal a) { return a.invalid(); }));
   }
 
+  bool MentionsLhsExactly(Term t) const { return any([t](Literal a) { return a.lhs() == t; }); }
+
 #ifdef BLOOM
   void InitBloom() {
     lhs_bloom_.Clear();
@@ -441,12 +526,13 @@ next:
   }
 #endif
 
-  size_t size_ = 0;
+  internal::u32 size_ = 0;
+  internal::u32 capacity2_ = 0;
 #ifdef BLOOM
   internal::BloomSet<Term> lhs_bloom_;
 #endif
   Literal lits1_[kArraySize];
-  std::unique_ptr<Literal[]> lits2_;
+  Literal* lits2_ = nullptr;
 };
 
 }  // namespace limbo
@@ -207,7 +207,7 @@ std::ostream& operator<<(std::ostream& os, const Clause& c) {
         internal::LexicographicComparator<
             PrintSymbolComparator,
             internal::LessComparator<Symbol::Arity>,
-            internal::LexicographicContainerComparator<Term::Vector, PrintTermComparator>> comp;
+            internal::LexicographicContainerComparator<Term::Args, PrintTermComparator>> comp;
         return comp(t1.symbol(), t1.arity(), t1.args(),
                     t2.symbol(), t2.arity(), t2.args());
       }
@@ -233,6 +233,10 @@ std::ostream& operator<<(std::ostream& os, const Clause& c) {
 #ifdef LIMBO_SETUP_H_
 #ifndef LIMBO_SETUP_OUTPUT
 #define LIMBO_SETUP_OUTPUT
+std::ostream& operator<<(std::ostream& os, const Setup::ClauseView& c) {
+  return os << Clause(c);
+}
+
 std::ostream& operator<<(std::ostream& os, const Setup& s) {
   auto is = s.clauses();
   auto cs = internal::transform_range(is.begin(), is.end(), [&s](size_t i) { return s.clause(i); });
@@ -0,0 +1,288 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Snapshots store a Setup in a versioned binary format, so that a setup which
+// is expensive to ground and minimize can be saved once and then be restored
+// quickly, for example, by several worker processes. A snapshot is a sequence
+// of 32-bit words in the byte order of the machine that wrote it:
+//
+//   header    magic number, version, byte-order mark, empty-clause flag, and
+//             the numbers of terms, arguments, units, clauses, and literals
+//   terms     four words per term: symbol, sort, arity, offset of arguments
+//   args      the arguments of the terms as indices in the term table
+//   units     two words per literal: lhs, and rhs << 1 | pos
+//   ends      for every clause, the end offset of its literals
+//   literals  the literals of the clauses, encoded like the units
+//
+// Arguments precede the terms that use them in the term table. Clauses are
+// stored after unit propagation, so that their first and last literals can
+// be watched right away.
+//
+// Read() loads a snapshot file into memory; a Snapshot can also wrap words
+// that are already in memory. Restore() interns the terms, whose ids are
+// specific to a process, and copies the units and clauses into an empty setup
+// without unit propagation, subsumption tests, or constructing Clause
+// objects. The symbols are restored with their original ids, so they should
+// be created in the same way before as when the snapshot was written.
+// Restore() reserves these ids in the Symbol::Factory, so that symbols
+// created afterwards are distinct from the restored ones.
+
+#ifndef LIMBO_FORMAT_SNAPSHOT_H_
+#define LIMBO_FORMAT_SNAPSHOT_H_
+
+#include <cassert>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <limbo/clause.h>
+#include <limbo/literal.h>
+#include <limbo/setup.h>
+#include <limbo/term.h>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace format {
+
+class Snapshot {
+ public:
+  typedef internal::u32 u32;
+  typedef internal::size_t size_t;
+
+  static constexpr u32 kFormatVersion = 1;
+
+  // Writes s to os and returns true iff this succeeded.
+  static bool Write(const Setup& s, std::ostream* os) {
+    std::unordered_map<Term, u32> index;
+    std::vector<u32> terms;
+    std::vector<u32> args;
+    auto encode = [&index, &terms, &args](std::vector<u32>* lits, Literal a) {
+      lits->push_back(AddTerm(a.lhs(), &index, &terms, &args));
+      lits->push_back(AddTerm(a.rhs(), &index, &terms, &args) << 1 | (a.pos() ? 1 : 0));
+    };
+    std::vector<u32> units;
+    for (const Literal a : s.units()) {
+      encode(&units, a);
+    }
+    std::vector<u32> ends;
+    std::vector<u32> lits;
+    for (const size_t i : s.clauses()) {
+      const Setup::ClauseView c = s.clause(i);
+      if (c.size() >= 2) {
+        for (const Literal a : c) {
+          encode(&lits, a);
+        }
+        ends.push_back(lits.size() / 2);
+      }
+    }
+    std::vector<u32> header(kHeaderSize);
+    header[kMagic0] = kMagic0Word;
+    header[kMagic1] = kMagic1Word;
+    header[kVersion] = kFormatVersion;
+    header[kByteOrder] = kByteOrderMark;
+    header[kEmptyClause] = s.contains_empty_clause() ? 1 : 0;
+    header[kTerms] = terms.size() / kTermSize;
+    header[kArgs] = args.size();
+    header[kUnits] = units.size() / 2;
+    header[kClauses] = ends.size();
+    header[kLiterals] = lits.size() / 2;
+    for (const std::vector<u32>* ws : {&header, &terms, &args, &units, &ends, &lits}) {
+      os->write(reinterpret_cast<const char*>(ws->data()), ws->size() * sizeof(u32));
+    }
+    return os->good();
+  }
+
+  // Reads the snapshot file at path, or returns an invalid snapshot if that
+  // fails.
+  static Snapshot Read(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = in ? static_cast<std::streamoff>(in.tellg()) : 0;
+    if (size <= 0) {
+      return Snapshot();
+    }
+    std::unique_ptr<u32[]> buffer(new u32[(size + sizeof(u32) - 1) / sizeof(u32)]);
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(buffer.get()), size)) {
+      return Snapshot();
+    }
+    Snapshot s(buffer.get(), size);
+    s.buffer_ = std::move(buffer);
+    return s;
+  }
+
+  Snapshot() = default;
+
+  // Wraps the snapshot of the given number of bytes at data, which must be
+  // aligned for 32-bit words and outlive the Snapshot object.
+  Snapshot(const void* data, size_t size) : data_(static_cast<const u32*>(data)), size_(size) {}
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+  Snapshot(Snapshot&& s) { *this = std::move(s); }
+  Snapshot& operator=(Snapshot&& s) {
+    data_ = s.data_;
+    size_ = s.size_;
+    buffer_ = std::move(s.buffer_);
+    s.data_ = nullptr;
+    s.size_ = 0;
+    return *this;
+  }
+
+  // valid() checks the header and that the snapshot is large enough for it;
+  // Restore() checks the remaining data.
+  bool valid() const {
+    if (!data_ || reinterpret_cast<internal::uptr_t>(data_) % alignof(u32) != 0 || size_ < kHeaderSize * sizeof(u32)) {
+      return false;
+    }
+    if (data_[kMagic0] != kMagic0Word || data_[kMagic1] != kMagic1Word ||
+        data_[kVersion] != kFormatVersion || data_[kByteOrder] != kByteOrderMark || data_[kEmptyClause] > 1) {
+      return false;
+    }
+    const internal::u64 n_words =
+        internal::u64(kHeaderSize) + internal::u64(kTermSize) * data_[kTerms] + data_[kArgs] +
+        internal::u64(2) * data_[kUnits] + data_[kClauses] + internal::u64(2) * data_[kLiterals];
+    return n_words * sizeof(u32) <= size_;
+  }
+
+  bool contains_empty_clause() const { return data_[kEmptyClause] == 1; }
+  size_t n_terms()             const { return data_[kTerms]; }
+  size_t n_units()             const { return data_[kUnits]; }
+  size_t n_clauses()           const { return data_[kClauses]; }
+  size_t n_literals()          const { return data_[kLiterals]; }
+
+  // Interns the terms of the snapshot with tf and reserves their symbols in
+  // sf, and adds its clauses to s, which must be empty. Returns false and
+  // leaves s untouched if the snapshot is malformed.
+  bool Restore(Symbol::Factory* sf, Term::Factory* tf, Setup* s) const {
+    assert(s->clauses().begin() == s->clauses().end());
+    if (!valid()) {
+      return false;
+    }
+    Term::Factory::Context ctx(tf);
+    std::vector<Term> terms;
+    terms.reserve(n_terms());
+    Term::Vector args;
+    for (size_t i = 0; i < n_terms(); ++i) {
+      const u32* w = term_words() + i * kTermSize;
+      if (w[2] > 255 || w[3] > data_[kArgs] || data_[kArgs] - w[3] < w[2] || (w[0] >> 2) == 0) {
+        return false;
+      }
+      args.clear();
+      for (u32 j = 0; j < w[2]; ++j) {
+        const u32 arg = arg_words()[w[3] + j];
+        if (arg >= i) {
+          return false;
+        }
+        args.push_back(terms[arg]);
+      }
+      const Symbol::Sort sort = static_cast<Symbol::Sort>(w[1]);
+      const Symbol::Arity arity = static_cast<Symbol::Arity>(w[2]);
+      if ((w[0] & 3) == 0 && arity == 0) {
+        const Symbol symbol = Symbol::Factory::CreateName(w[0] >> 2, sort);
+        sf->Reserve(symbol);
+        terms.push_back(tf->CreateTerm(symbol, args));
+      } else if ((w[0] & 3) == 2) {
+        const Symbol symbol = Symbol::Factory::CreateFunction(w[0] >> 2, sort, arity);
+        sf->Reserve(symbol);
+        terms.push_back(tf->CreateTerm(symbol, args));
+      } else {
+        return false;
+      }
+    }
+    auto valid_literal = [&terms](const u32* w) {
+      return w[0] < terms.size() && (w[1] >> 1) < terms.size() &&
+          terms[w[0]].primitive() && terms[w[1] >> 1].name() && terms[w[0]].sort() == terms[w[1] >> 1].sort();
+    };
+    for (size_t i = 0; i < n_units(); ++i) {
+      if (!valid_literal(unit_words() + 2 * i)) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < n_clauses(); ++i) {
+      const u32 begin = i > 0 ? end_words()[i - 1] : 0;
+      if (end_words()[i] > n_literals() || end_words()[i] < begin + 2) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < n_literals(); ++i) {
+      if (!valid_literal(literal_words() + 2 * i)) {
+        return false;
+      }
+    }
+    auto literal = [&terms](const u32* w) {
+      const Term lhs = terms[w[0]];
+      const Term rhs = terms[w[1] >> 1];
+      return (w[1] & 1) ? Literal::Eq(lhs, rhs) : Literal::Neq(lhs, rhs);
+    };
+    for (size_t i = 0; i < n_units(); ++i) {
+      s->AddUnit(literal(unit_words() + 2 * i));
+    }
+    std::vector<Literal> lits;
+    for (size_t i = 0; i < n_clauses(); ++i) {
+      lits.clear();
+      for (u32 j = i > 0 ? end_words()[i - 1] : 0; j < end_words()[i]; ++j) {
+        lits.push_back(literal(literal_words() + 2 * j));
+      }
+      // The order of the literals depends on the term ids.
+      std::sort(lits.begin(), lits.end());
+      s->RestoreClause(lits.begin(), lits.end());
+    }
+    if (contains_empty_clause()) {
+      s->AddClause(Clause());
+    }
+    return true;
+  }
+
+ private:
+  enum HeaderWord {
+    kMagic0, kMagic1, kVersion, kByteOrder, kEmptyClause, kTerms, kArgs, kUnits, kClauses, kLiterals, kHeaderSize
+  };
+
+  static constexpr u32 kMagic0Word = 0x424D494C;  // "LIMB" in little endian
+  static constexpr u32 kMagic1Word = 0x50414E53;  // "SNAP" in little endian
+  static constexpr u32 kByteOrderMark = 0x01020304;
+  static constexpr u32 kTermSize = 4;
+
+  static u32 AddTerm(Term t, std::unordered_map<Term, u32>* index, std::vector<u32>* terms, std::vector<u32>* args) {
+    auto it = index->find(t);
+    if (it != index->end()) {
+      return it->second;
+    }
+    std::vector<u32> arg_indices;
+    for (const Term arg : t.args()) {
+      arg_indices.push_back(AddTerm(arg, index, terms, args));
+    }
+    const Symbol sym = t.symbol();
+    assert(!sym.variable());
+    terms->push_back(sym.id() << 2 | (sym.function() ? 2 : 0));
+    terms->push_back(sym.sort());
+    terms->push_back(sym.arity());
+    terms->push_back(args->size());
+    args->insert(args->end(), arg_indices.begin(), arg_indices.end());
+    const u32 i = terms->size() / kTermSize - 1;
+    index->insert(std::make_pair(t, i));
+    return i;
+  }
+
+  const u32* term_words()    const { return data_ + kHeaderSize; }
+  const u32* arg_words()     const { return term_words() + kTermSize * data_[kTerms]; }
+  const u32* unit_words()    const { return arg_words() + data_[kArgs]; }
+  const u32* end_words()     const { return unit_words() + 2 * data_[kUnits]; }
+  const u32* literal_words() const { return end_words() + data_[kClauses]; }
+
+  const u32* data_ = nullptr;
+  size_t size_ = 0;
+  std::unique_ptr<u32[]> buffer_;
+};
+
+}  // namespace format
+}  // namespace limbo
+
+#endif  // LIMBO_FORMAT_SNAPSHOT_H_
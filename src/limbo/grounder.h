@@ -9,11 +9,38 @@
 // PrepareForQuery(), or GuaranteeConsistency() are called. In particular,
 // the relevant standard names (including the additional names) are managed and
 // the clauses are regrounded accordingly. The Grounder is designed for fast
-// backtracking.
+// backtracking. These methods resolve terms with the Grounder's Term::Factory,
+// whichever factory is current in the calling thread.
 //
 // PrepareForQuery() should not be called before GuaranteeConsistency().
 // Otherwise their behaviour is undefined.
 //
+// Every ungrounded clause, query literal, and relevant term is compiled into
+// a Plan when it is added, so that grounding it amounts to writing names into
+// variable slots and creating the terms that depend on these slots. With
+// set_memo_slots(), these terms are memoized in a Term::SubstitutionMemo per
+// thread, which pays off when regrounding mostly creates terms that it created
+// before and these fit into the memo.
+//
+// In lazy mode, which is enabled with set_lazy(), clauses with variables are
+// not grounded when they are added. Queries with consistency guarantee only
+// see the clauses that are relevant to the query's terms, and lazy mode
+// grounds just these: starting from the query's terms, it follows the
+// clauses with a literal whose left-hand side matches a relevant term. A
+// query without consistency guarantee grounds all clauses first; since this
+// is undone after the query, lazy mode only pays off when most queries come
+// with consistency guarantee. The minimized relevant clauses of a query are
+// cached in the ply below it, so repeating a query with the same terms does
+// not ground and minimize them again.
+//
+// Regrounding may be distributed over several threads with set_n_threads().
+// The assignments of names to variables are then split into jobs, which the
+// threads ground into separate buffers, and the buffers are processed in the
+// order of the jobs, so that the result does not depend on the number of
+// threads or their timing. This happens in chunks of jobs, so that only a
+// bounded number of groundings is buffered at a time. Small regroundings are
+// done in the calling thread.
+//
 // Quantification requires the temporary use of additional standard names.
 // Grounder uses a temporary NamePool where names can be returned for later
 // re-use. This NamePool is public for it can also be used to handle free
@@ -26,9 +53,13 @@
 #include <cassert>
 
 #include <algorithm>
+#include <atomic>
 #include <list>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <queue>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
@@ -91,6 +122,204 @@ class Grounder {
 
   typedef Formula::SortedTermSet SortedTermSet;
 
+  // A Plan is a term, literal, or clause compiled for grounding. The
+  // variables are numbered slots, and the non-ground subterms are nodes in
+  // post-order whose arguments are indices of slots, ground terms, or earlier
+  // nodes. Ground() assigns names to the slots like an odometer, where the last
+  // slot changes fastest, and re-creates only the nodes that depend on a slot
+  // that has changed. For example, f(x) in g(f(x),y) is created once per name
+  // of x, not once per name of x and y. If a Term::SubstitutionMemo is given,
+  // the nodes are looked up in it by their term and the names of their
+  // variables, which are stored in the order of their first occurrence, as in
+  // Term::SubstitutionMemo::Substitute().
+  template<typename T>
+  class Plan {
+   public:
+    explicit Plan(const T& obj) {
+      obj.Traverse([this](Term t) {
+        if (t.variable() && std::find(vars_.begin(), vars_.end(), t) == vars_.end()) {
+          vars_.push_back(t);
+        }
+        return true;
+      });
+      std::unordered_map<Term, u32> nodes;
+      Compile(obj, &nodes);
+      // Ground terms are stored after the nodes, whose number is known now.
+      const u32 offset = vars_.size() + nodes_.size();
+      auto resolve = [offset](u32& i) { if (i & kGroundBit) { i = offset + (i & ~kGroundBit); } };
+      std::for_each(args_.begin(), args_.end(), resolve);
+      for (LiteralPlan& a : lits_) {
+        resolve(a.lhs);
+        resolve(a.rhs);
+      }
+      resolve(root_);
+    }
+
+    const Term::Vector& vars() const { return vars_; }
+
+    // Calls f for every grounding where vars()[i] is substituted by the names
+    // in domain(i), until f returns false, in which case Ground() returns
+    // false as well.
+    template<typename DomainFunction, typename UnaryPredicate>
+    bool Ground(Term::Factory* tf, DomainFunction domain, UnaryPredicate f,
+                Term::SubstitutionMemo* memo = nullptr) const {
+      const size_t n_slots = vars_.size();
+      std::vector<const Term::Vector*> domains(n_slots);
+      for (size_t i = 0; i < n_slots; ++i) {
+        domains[i] = &domain(i);
+        if (domains[i]->empty()) {
+          return true;
+        }
+      }
+      Term::Vector values(n_slots + nodes_.size());
+      for (size_t i = 0; i < n_slots; ++i) {
+        values[i] = (*domains[i])[0];
+      }
+      values.insert(values.end(), ground_.begin(), ground_.end());
+      std::vector<size_t> indices(n_slots, 0);
+      Term::Vector args(max_arity_);
+      std::vector<Literal> lits;
+      T g;
+      for (size_t changed = 0; ; ) {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+          const Node& node = nodes_[i];
+          if (node.level >= changed) {
+            for (size_t j = 0; j < node.arity; ++j) {
+              args[j] = values[args_[node.args + j]];
+            }
+            auto create = [tf, &node, &args]() {
+              return tf->CreateTerm(node.symbol, args.data(), args.data() + node.arity);
+            };
+            if (memo && node.n_vars <= Term::SubstitutionMemo::kMaxVars) {
+              Term names[Term::SubstitutionMemo::kMaxVars];
+              for (size_t j = 0; j < node.n_vars; ++j) {
+                names[j] = values[node_vars_[node.vars + j]];
+              }
+              values[n_slots + i] = memo->Lookup(node.term, names, node.n_vars, create);
+            } else {
+              values[n_slots + i] = create();
+            }
+          }
+        }
+        Make(values, &lits, &g);
+        if (!f(g)) {
+          return false;
+        }
+        size_t i = n_slots;
+        for (;;) {
+          if (i == 0) {
+            return true;
+          }
+          --i;
+          if (++indices[i] < domains[i]->size()) {
+            values[i] = (*domains[i])[indices[i]];
+            break;
+          }
+          indices[i] = 0;
+          values[i] = (*domains[i])[0];
+        }
+        changed = i;
+      }
+    }
+
+   private:
+    typedef internal::u32 u32;
+
+    struct Node {
+      Term term;
+      Symbol symbol;
+      u32 args;    // offset in args_
+      u32 arity;
+      u32 level;   // greatest slot the node depends on
+      u32 vars;    // offset in node_vars_
+      u32 n_vars;  // number of slots the node depends on
+    };
+
+    struct LiteralPlan {
+      bool pos;
+      u32 lhs;
+      u32 rhs;
+    };
+
+    static constexpr u32 kGroundBit = 1u << 31;
+
+    void Compile(const Term t, std::unordered_map<Term, u32>* nodes) { root_ = CompileTerm(t, nodes); }
+    void Compile(const Literal a, std::unordered_map<Term, u32>* nodes) {
+      lits_.push_back(LiteralPlan{a.pos(), CompileTerm(a.lhs(), nodes), CompileTerm(a.rhs(), nodes)});
+    }
+    void Compile(const Clause& c, std::unordered_map<Term, u32>* nodes) {
+      for (const Literal a : c) {
+        Compile(a, nodes);
+      }
+    }
+
+    // Returns the index of t in the values of Ground(), where ground terms are
+    // marked with kGroundBit until their index is known.
+    u32 CompileTerm(const Term t, std::unordered_map<Term, u32>* nodes) {
+      if (t.variable()) {
+        return std::find(vars_.begin(), vars_.end(), t) - vars_.begin();
+      }
+      if (t.ground()) {
+        ground_.push_back(t);
+        return kGroundBit | (ground_.size() - 1);
+      }
+      auto it = nodes->find(t);
+      if (it != nodes->end()) {
+        return it->second;
+      }
+      std::vector<u32> args;
+      std::vector<u32> vars;
+      auto add_var = [&vars](u32 i) {
+        if (std::find(vars.begin(), vars.end(), i) == vars.end()) {
+          vars.push_back(i);
+        }
+      };
+      u32 level = 0;
+      for (const Term arg : t.args()) {
+        const u32 i = CompileTerm(arg, nodes);
+        args.push_back(i);
+        if (i < vars_.size()) {
+          level = std::max(level, i);
+          add_var(i);
+        } else if (!(i & kGroundBit)) {
+          const Node& node = nodes_[i - vars_.size()];
+          level = std::max(level, node.level);
+          std::for_each(node_vars_.begin() + node.vars, node_vars_.begin() + node.vars + node.n_vars, add_var);
+        }
+      }
+      nodes_.push_back(Node{t, t.symbol(), static_cast<u32>(args_.size()), static_cast<u32>(args.size()), level,
+                            static_cast<u32>(node_vars_.size()), static_cast<u32>(vars.size())});
+      args_.insert(args_.end(), args.begin(), args.end());
+      node_vars_.insert(node_vars_.end(), vars.begin(), vars.end());
+      max_arity_ = std::max(max_arity_, args.size());
+      const u32 i = vars_.size() + nodes_.size() - 1;
+      nodes->insert(std::make_pair(t, i));
+      return i;
+    }
+
+    void Make(const Term::Vector& values, std::vector<Literal>*, Term* t) const { *t = values[root_]; }
+    void Make(const Term::Vector& values, std::vector<Literal>*, Literal* a) const {
+      const LiteralPlan& l = lits_[0];
+      *a = l.pos ? Literal::Eq(values[l.lhs], values[l.rhs]) : Literal::Neq(values[l.lhs], values[l.rhs]);
+    }
+    void Make(const Term::Vector& values, std::vector<Literal>* lits, Clause* c) const {
+      lits->clear();
+      for (const LiteralPlan& l : lits_) {
+        lits->push_back(l.pos ? Literal::Eq(values[l.lhs], values[l.rhs]) : Literal::Neq(values[l.lhs], values[l.rhs]));
+      }
+      *c = Clause(lits->size(), lits->begin(), lits->end());
+    }
+
+    Term::Vector vars_;
+    Term::Vector ground_;
+    std::vector<Node> nodes_;
+    std::vector<u32> args_;
+    std::vector<u32> node_vars_;
+    std::vector<LiteralPlan> lits_;
+    u32 root_ = 0;
+    size_t max_arity_ = 0;
+  };
+
   template<typename T>
   struct Ungrounded {
     typedef T value_type;
@@ -107,7 +336,9 @@ class Grounder {
    private:
     friend class Grounder;
 
-    explicit Ungrounded(const T& val) : val(val) {}
+    explicit Ungrounded(const T& val) : val(val), plan(std::make_shared<const Plan<T>>(val)) {}
+
+    std::shared_ptr<const Plan<T>> plan;  // shared by the copies in merged plies
   };
 
   struct Ply {
@@ -139,6 +370,8 @@ class Grounder {
       std::unordered_map<Term, std::unordered_set<Term>> map;  // grounded lhs-rhs index for clauses, prepared-for query
     } lhs_rhs;
     bool do_not_add_if_inconsistent = false;  // enabled for fix-literals
+    bool lazy = false;  // clauses with variables are grounded only for relevant terms
+    std::map<std::vector<Term>, std::vector<Clause>> lazy_setups;  // minimized relevant clauses of queries on this ply
 
    private:
     friend class Grounder;
@@ -382,6 +615,50 @@ class Grounder {
 
   const Setup& setup() const { return plies_.empty() ? dummy_setup_ : last_ply().clauses.shallow_setup.setup(); }
 
+  // The number of ground clauses generated by regrounding, and how many of
+  // them were added to the setup, that is, were neither valid nor subsumed.
+  // The difference is the redundant work of grounding.
+  size_t n_generated_clauses() const { return n_generated_clauses_; }
+  size_t n_added_clauses() const { return n_added_clauses_; }
+
+  // Regrounding memoizes the non-ground terms of clauses and queries in a
+  // Term::SubstitutionMemo with the given number of slots per thread, or not
+  // at all if it is zero, which is the default. The memo saves re-creating
+  // terms when the same groundings recur and fit into it, but slows down
+  // regrounding when they do not.
+  size_t memo_slots() const { return memo_slots_; }
+  void set_memo_slots(size_t n) {
+    memo_slots_ = n;
+    memos_.clear();
+    ResizeMemos();
+  }
+
+  // The hits and misses of the memos.
+  size_t n_memo_hits() const {
+    return std::accumulate(memos_.begin(), memos_.end(), size_t(0),
+                           [](size_t n, const std::unique_ptr<Term::SubstitutionMemo>& m) { return n + m->n_hits(); });
+  }
+  size_t n_memo_misses() const {
+    return std::accumulate(memos_.begin(), memos_.end(), size_t(0),
+                           [](size_t n, const std::unique_ptr<Term::SubstitutionMemo>& m) { return n + m->n_misses(); });
+  }
+
+  // The number of threads used for regrounding; 1 means that regrounding
+  // happens in the calling thread only.
+  size_t n_threads() const { return n_threads_; }
+  void set_n_threads(size_t n) {
+    n_threads_ = n > 0 ? n : 1;
+    ResizeMemos();
+  }
+
+  // Lazy mode must be chosen before the first clause is added. It should not
+  // be used when many queries come without consistency guarantee, because
+  // each of them grounds all clauses and undoes this afterwards, or when most
+  // clauses are relevant to most queries, because then every query grounds
+  // and minimizes about the whole setup.
+  bool lazy() const { return lazy_; }
+  void set_lazy(bool b) { assert(plies_.empty()); lazy_ = b; }
+
   // 1. AddClause(c):
   // New ply.
   // Add c to ungrounded_clauses.
@@ -428,6 +705,7 @@ class Grounder {
   // inconsistent.
 
   Setup::Result AddClause(const Clause& c, Undo* undo = nullptr, bool do_not_add_if_inconsistent = false) {
+    Term::Factory::Context ctx(tf_);
     auto r = internal::singleton_range(c);
     return AddClauses(r.begin(), r.end(), undo, do_not_add_if_inconsistent);
   }
@@ -437,6 +715,7 @@ class Grounder {
                            InputIt last,
                            Undo* undo = nullptr,
                            const bool do_not_add_if_inconsistent = false) {
+    Term::Factory::Context ctx(tf_);
     // Add c to ungrounded_clauses.
     // Add new names in c to names.
     // Add variables to vars, generate plus-names.
@@ -472,6 +751,7 @@ class Grounder {
   }
 
   void PrepareForQuery(const Term t, Undo* undo = nullptr) {
+    Term::Factory::Context ctx(tf_);
     const Term x = var_pool_.Create(t.sort());
     const Literal a = Literal::Eq(t, x);
     const Formula::Ref phi = Formula::Factory::Atomic(Clause{a});
@@ -480,6 +760,7 @@ class Grounder {
   }
 
   void PrepareForQuery(const Formula& phi, Undo* undo = nullptr) {
+    Term::Factory::Context ctx(tf_);
     // New ply.
     // Add new names in phi to names.
     // Add variables to vars, generate plus-names.
@@ -509,6 +790,9 @@ class Grounder {
     });
     CreateNewPlusNames(p.names.plus_mentioned);
     CreateMaxPlusNames(phi.n_vars());  // XXX or CreateNewPlusNames()?
+    if (p.lazy && !p.relevant.filter) {
+      GroundDeferredClauses();
+    }
     Reground();
     if (undo) {
       *undo = Undo(this);
@@ -516,6 +800,7 @@ class Grounder {
   }
 
   void GuaranteeConsistency(const Formula& alpha, Undo* undo) {
+    Term::Factory::Context ctx(tf_);
     // Collect ungrounded terms from query.
     // Close under terms in current setup.
     Ply& p = new_ply();
@@ -528,12 +813,15 @@ class Grounder {
       }
       return false;
     });
+    NameVectors ns(this);
     for (const Ungrounded<Term>& u : p.relevant.ungrounded) {
-      for (const Term g : groundings(&u.val, &u.vars)) {
+      ns.Fill(*u.plan);
+      Ground(u, ns, 0, Term(), [&p](const Term g) {
         p.relevant.terms.insert(g);
-      }
+        return true;
+      }, memo(0));
     }
-    CloseRelevanceUnderClauses(p.clauses.shallow_setup.setup().clauses(), Plies::kNew);
+    CloseRelevanceUnderSetup();
     GroundNewSetup();
     if (undo) {
       *undo = Undo(this);
@@ -541,6 +829,7 @@ class Grounder {
   }
 
   void GuaranteeConsistency(Term t, Undo* undo) {
+    Term::Factory::Context ctx(tf_);
     // Add t to ungrounded terms from query.
     // Close under terms in current setup.
     assert(t.primitive());
@@ -548,18 +837,25 @@ class Grounder {
     p.relevant.filter = true;
     p.relevant.ungrounded.insert(Ungrounded<Term>(t));
     p.relevant.terms.insert(t);
-    CloseRelevanceUnderClauses(p.clauses.shallow_setup.setup().clauses(), Plies::kNew);
+    CloseRelevanceUnderSetup();
     GroundNewSetup();
     if (undo) {
       *undo = Undo(this);
     }
   }
 
-  void UndoLast() { pop_ply(); }
+  void UndoLast() {
+    Term::Factory::Context ctx(tf_);
+    pop_ply();
+  }
 
-  void Consolidate() { MergePlies(true); }
+  void Consolidate() {
+    Term::Factory::Context ctx(tf_);
+    MergePlies(true);
+  }
 
   Literal Variablify(Literal a) {
+    Term::Factory::Context ctx(tf_);
     assert(a.ground());
     Term::Vector ns;
     a.lhs().Traverse([&ns](Term t) {
@@ -580,91 +876,73 @@ class Grounder {
   Names names(Symbol::Sort sort, Plies::Policy p = Plies::kAll) const { return Names(this, sort, p); }
 
  private:
-  template<typename T>
-  struct Groundings {
+  // NameVectors holds the names of every sort for one round of grounding,
+  // so that plans enumerate vectors instead of Names iterators. Besides all
+  // names, it keeps the names from the last ply and those from the older
+  // plies. Since Fill() may resize the vectors, all sorts must be filled
+  // before the NameVectors is shared between threads.
+  class NameVectors {
    public:
-    struct Assignments {
-     public:
-      struct NotX {
-        explicit NotX(Term x) : x(x) {}
-
-        bool operator()(Term y) const { return x != y; }
-
-       private:
-        const Term x;
-      };
-
-      struct DomainCodomain {
-        DomainCodomain(const Grounder* owner, Plies::Policy policy) : owner(owner), policy(policy) {}
-
-        std::pair<Term, Names> operator()(const Term x) const {
-          return std::make_pair(x, owner->names(x.sort(), policy));
+    explicit NameVectors(const Grounder* owner) : owner_(owner) {}
+
+    template<typename T>
+    void Fill(const Plan<T>& plan) {
+      for (const Term x : plan.vars()) {
+        const Symbol::Sort sort = x.sort();
+        if (!filled_[sort]) {
+          filled_[sort] = true;
+          for (const Term n : owner_->names(sort, Plies::kNew)) {
+            new_[sort].push_back(n);
+          }
+          for (const Term n : owner_->names(sort, Plies::kOld)) {
+            old_[sort].push_back(n);
+          }
+          all_[sort] = new_[sort];
+          all_[sort].insert(all_[sort].end(), old_[sort].begin(), old_[sort].end());
         }
-
-       private:
-        const Grounder* const owner;
-        const Plies::Policy policy;
-      };
-
-      typedef internal::filter_iterator<SortedTermSet::all_values_iterator, NotX> vars_iterator;
-      typedef internal::transform_iterator<vars_iterator, DomainCodomain> var_names_iterator;
-      typedef internal::mapping_iterator<Term, Names::iterator> iterator;
-
-      Assignments(const Grounder* owner, const SortedTermSet* vars, Plies::Policy policy, Term x, Term n)
-          : vars(vars), owner(owner), policy(policy), x(x), n(n) {}
-
-      iterator begin() const {
-        auto p = NotX(x);
-        auto f = DomainCodomain(owner, policy);
-        auto b = vars->begin();
-        auto e = vars->end();
-        return iterator(var_names_iterator(vars_iterator(b, e, p), f), var_names_iterator(vars_iterator(e, e, p), f));
       }
-      iterator end() const { return iterator(); }
-
-     private:
-      const SortedTermSet* const vars;
-      const Grounder* const owner;
-      const Plies::Policy policy;
-      const Term x;
-      const Term n;
-    };
-
-    struct Ground {
-      Ground(Term::Factory* tf, const T* obj, Term x, Term n) : tf_(tf), obj(obj), x(x), n(n) {}
-      T operator()(const typename Assignments::iterator::value_type& assignment) const {
-        auto substitution = [this, &assignment](Term y) { return x == y ? internal::Just(n) : assignment(y); };
-        return obj->Substitute(substitution, tf_);
-      }
-     private:
-      Term::Factory* const tf_;
-      const T* const obj;
-      const Term x;
-      const Term n;
-    };
-
-    typedef internal::transform_iterator<typename Assignments::iterator, Ground> iterator;
-
-    Groundings(const Grounder* owner, const T* obj, const SortedTermSet* vars, Term x, Term n, Plies::Policy p)
-        : x(x), n(n), assignments(owner, vars, p, x, n), ground(owner->tf_, obj, x, n) {}
+    }
 
-    iterator begin() const { return iterator(assignments.begin(), ground); }
-    iterator end()   const { return iterator(assignments.end(), ground); }
+    const Term::Vector& all_names(Symbol::Sort sort) const { assert(filled_[sort]); return all_[sort]; }
+    const Term::Vector& old_names(Symbol::Sort sort) const { assert(filled_[sort]); return old_[sort]; }
+    const Term::Vector& new_names(Symbol::Sort sort) const { assert(filled_[sort]); return new_[sort]; }
 
    private:
-    Term x;
-    Term n;
-    Assignments assignments;
-    Ground ground;
+    const Grounder* const owner_;
+    internal::IntMap<Symbol::Sort, Term::Vector> all_;
+    internal::IntMap<Symbol::Sort, Term::Vector> old_;
+    internal::IntMap<Symbol::Sort, Term::Vector> new_;
+    internal::IntMap<Symbol::Sort, bool> filled_;
   };
 
-  template<typename T>
-  Groundings<T> groundings(const T* o, const SortedTermSet* vars, Plies::Policy p = Plies::kAll) const {
-    return groundings(o, vars, Term(), Term(), p);
+  // Grounds u for all names, where the i-th variable is substituted by n if
+  // n is not null.
+  template<typename T, typename UnaryPredicate>
+  bool Ground(const Ungrounded<T>& u, const NameVectors& ns, size_t i, Term n, UnaryPredicate f,
+              Term::SubstitutionMemo* memo) const {
+    const Term::Vector& vars = u.plan->vars();
+    const Term::Vector in{n};
+    return u.plan->Ground(tf_, [&vars, &ns, i, n, &in](size_t j) -> const Term::Vector& {
+      return j == i && !n.null() ? in : ns.all_names(vars[j].sort());
+    }, f, memo);
   }
-  template<typename T>
-  Groundings<T> groundings(const T* o, const SortedTermSet* vars, Term x, Term n, Plies::Policy p = Plies::kAll) const {
-    return Groundings<T>(this, o, vars, x, n, p);
+
+  // Grounds u for the assignments where the i-th variable is the first one
+  // that is substituted by a new name: the variables before it range over the
+  // old names, the i-th over the new names, and the ones after it over all
+  // names. The groundings for i = 0, 1, ... are hence disjoint, and together
+  // they are exactly the groundings that mention a new name (semi-naive
+  // grounding). If n is not null, the first variable is substituted only by
+  // n, which must be in its range.
+  template<typename T, typename UnaryPredicate>
+  bool GroundNew(const Ungrounded<T>& u, const NameVectors& ns, size_t i, Term n, UnaryPredicate f,
+                 Term::SubstitutionMemo* memo) const {
+    const Term::Vector& vars = u.plan->vars();
+    const Term::Vector in{n};
+    return u.plan->Ground(tf_, [&vars, &ns, i, n, &in](size_t j) -> const Term::Vector& {
+      const Symbol::Sort sort = vars[j].sort();
+      return j == 0 && !n.null() ? in : j < i ? ns.old_names(sort) : j > i ? ns.all_names(sort) : ns.new_names(sort);
+    }, f, memo);
   }
 
   Ply& new_ply() {
@@ -673,6 +951,7 @@ class Grounder {
       Ply& p = plies_.back();
       p.clauses.full_setup = std::unique_ptr<Setup>(new Setup());
       p.clauses.shallow_setup = p.clauses.full_setup->shallow_copy();
+      p.lazy = lazy_;
       return p;
     } else {
       Ply& last_p = last_ply();
@@ -680,6 +959,7 @@ class Grounder {
       Ply& p = plies_.back();
       p.clauses.shallow_setup = last_p.clauses.shallow_setup.setup().shallow_copy();
       p.relevant.filter = last_p.relevant.filter;
+      p.lazy = last_p.lazy;
       return p;
     }
   }
@@ -692,6 +972,19 @@ class Grounder {
   Setup& last_setup() { return last_ply().clauses.shallow_setup.setup(); }
   const Setup& last_setup() const { return last_ply().clauses.shallow_setup.setup(); }
 
+  // Returns the memo of thread i, or null if memoization is disabled.
+  Term::SubstitutionMemo* memo(size_t i) const { return i < memos_.size() ? memos_[i].get() : nullptr; }
+
+  void ResizeMemos() {
+    if (memo_slots_ == 0) {
+      return;
+    }
+    while (memos_.size() < n_threads_) {
+      memos_.push_back(std::unique_ptr<Term::SubstitutionMemo>(new Term::SubstitutionMemo(memo_slots_)));
+    }
+    memos_.resize(n_threads_);
+  }
+
   void pop_ply() {
     assert(!plies_.empty());
     Ply& p = last_ply();
@@ -735,7 +1028,8 @@ class Grounder {
     return true;
   }
 
-  bool IsRelevantClause(const Clause& c, Plies::Policy p) const {
+  template<typename ClauseType>
+  bool IsRelevantClause(const ClauseType& c, Plies::Policy p) const {
     if (!last_ply().relevant.filter) {
       return true;
     }
@@ -828,7 +1122,8 @@ class Grounder {
     }
   }
 
-  void UpdateLhsRhs(const Clause& c, Plies::Policy p) {
+  template<typename ClauseType>
+  void UpdateLhsRhs(const ClauseType& c, Plies::Policy p) {
     for (const Literal a : c) {
       UpdateLhsRhs(a, p);
     }
@@ -838,10 +1133,14 @@ class Grounder {
     assert(t.ground());
     if (t.function() && IsNewRelevantTerm(t, p)) {
       last_ply().relevant.terms.insert(t);
+      if (last_ply().lazy) {
+        relevant_queue_.push_back(t);
+      }
     }
   }
 
-  bool UpdateRelevantTerms(const Clause& c, Plies::Policy p) {
+  template<typename ClauseType>
+  bool UpdateRelevantTerms(const ClauseType& c, Plies::Policy p) {
     assert(c.ground());
     assert(!c.valid());
     if (c.any([this, p](const Literal a) { return !IsNewRelevantTerm(a.lhs(), p); })) {
@@ -857,18 +1156,45 @@ class Grounder {
 
   template<typename ClauseRange>
   void CloseRelevanceUnderClauses(ClauseRange r, Plies::Policy p) {
-    std::unordered_set<size_t> clauses;
+    // A clause is relevant if one of its terms is relevant, and then all its
+    // terms are relevant. Clauses that are not relevant yet are indexed by
+    // their terms, and the newly relevant terms are processed as a worklist,
+    // so that every clause is visited once per term.
+    Setup& s = last_setup();
+    std::unordered_map<Term, std::vector<size_t>> occurrences;
+    std::unordered_set<size_t> relevant;
+    std::vector<Term> worklist;
+    auto make_relevant = [this, &s, p, &worklist](size_t i) {
+      for (const Literal a : s.CachedClause(i)) {
+        if (IsNewRelevantTerm(a.lhs(), p)) {
+          UpdateRelevantTerms(a.lhs(), p);
+          worklist.push_back(a.lhs());
+        }
+      }
+    };
     for (size_t i : r) {
-      clauses.insert(i);
+      const Setup::ClauseView c = s.CachedClause(i);
+      if (c.any([this, p](const Literal a) { return !IsNewRelevantTerm(a.lhs(), p); })) {
+        make_relevant(i);
+      } else {
+        for (const Literal a : c) {
+          occurrences[a.lhs()].push_back(i);
+        }
+      }
     }
-rescan:
-    for (auto it = clauses.begin(); it != clauses.end(); ++it) {
-      const Clause c = last_ply().clauses.shallow_setup.setup().clause(*it);
-      bool relevant = UpdateRelevantTerms(c, p);
-      if (relevant) {
-        clauses.erase(it);
-        goto rescan;
+    while (!worklist.empty()) {
+      const Term t = worklist.back();
+      worklist.pop_back();
+      auto it = occurrences.find(t);
+      if (it == occurrences.end()) {
+        continue;
+      }
+      for (size_t i : it->second) {
+        if (relevant.insert(i).second) {
+          make_relevant(i);
+        }
       }
+      occurrences.erase(it);
     }
   }
 
@@ -880,47 +1206,403 @@ rescan:
   void ForEachGrounding(UnaryFunction range, UnaryPredicate pred, Setup::Result* add_result = nullptr) {
     typedef decltype(range(std::declval<Ply>()).begin()) iterator;
     typedef typename iterator::value_type::value_type value_type;
+    NameVectors ns(this);
     for (const Ply& p : plies_) {
       for (const Ungrounded<value_type>& u : range(p)) {
-        for (const value_type& g : groundings(&u.val, &u.vars)) {
+        ns.Fill(*u.plan);
+        const bool go_on = Ground(u, ns, 0, Term(), [&pred, &p, add_result](const value_type& g) {
           assert(g.ground());
           pred(g, p, add_result);
-          if (add_result && *add_result == Setup::kInconsistent) {
-            return;
-          }
+          return !add_result || *add_result != Setup::kInconsistent;
+        }, memo(0));
+        if (!go_on) {
+          return;
         }
       }
     }
   }
 
+  // Grounds the old plies for the new names of the last ply, where every
+  // grounding is generated only once, and the last ply for all names.
   template<typename UnaryFunction, typename UnaryPredicate>
   void ForEachNewGrounding(UnaryFunction range, UnaryPredicate pred, Setup::Result* add_result = nullptr) {
     typedef decltype(range(std::declval<Ply>()).begin()) iterator;
     typedef typename iterator::value_type::value_type value_type;
+    if (n_threads_ > 1) {
+      ForEachNewGroundingInParallel<value_type>(range, pred, add_result);
+      return;
+    }
+    NameVectors ns(this);
     for (const Ply& p : plies(Plies::kOld)) {
       for (const Ungrounded<value_type>& u : range(p)) {
-        for (const Term x : u.vars) {
-          for (const Term n : names(x.sort(), Plies::kNew)) {
-            for (const value_type& g : groundings(&u.val, &u.vars, x, n)) {
-              assert(g.ground());
-              pred(g, p, add_result);
-              if (add_result && *add_result == Setup::kInconsistent) {
-                return;
-              }
-            }
+        ns.Fill(*u.plan);
+        for (size_t i = 0; i < u.plan->vars().size(); ++i) {
+          const bool go_on = GroundNew(u, ns, i, Term(), [&pred, &p, add_result](const value_type& g) {
+            assert(g.ground());
+            pred(g, p, add_result);
+            return !add_result || *add_result != Setup::kInconsistent;
+          }, memo(0));
+          if (!go_on) {
+            return;
           }
         }
       }
     }
     const Ply& p = last_ply();
     for (const Ungrounded<value_type>& u : range(p)) {
-      for (const value_type& g : groundings(&u.val, &u.vars)) {
+      ns.Fill(*u.plan);
+      const bool go_on = Ground(u, ns, 0, Term(), [&pred, &p, add_result](const value_type& g) {
         pred(g, p, add_result);
-        if (add_result && *add_result == Setup::kInconsistent) {
-          return;
+        return !add_result || *add_result != Setup::kInconsistent;
+      }, memo(0));
+      if (!go_on) {
+        return;
+      }
+    }
+  }
+
+  // A GroundingJob is the set of groundings of u where the first variable is
+  // substituted by n, or all groundings of u if n is null. If delta is true,
+  // these are only the groundings from GroundNew() for the i-th variable.
+  // The job is expected to yield size groundings.
+  template<typename T>
+  struct GroundingJob {
+    GroundingJob(const Ply* p, const Ungrounded<T>* u, bool delta, size_t i, Term n, size_t size)
+        : p(p), u(u), delta(delta), i(i), n(n), size(size) {}
+
+    const Ply* p;
+    const Ungrounded<T>* u;
+    bool delta;
+    size_t i;
+    Term n;
+    size_t size;
+    std::vector<T> groundings;
+  };
+
+  // Enumerates the same groundings in the same order as the serial loops of
+  // ForEachNewGrounding(), but they are split into jobs by the name of their
+  // first variable, which changes slowest in a plan. The jobs are processed in
+  // chunks of about kMaxBufferedGroundings groundings: the threads ground the
+  // jobs of a chunk, and then pred is called for their groundings in the order
+  // of the jobs before the next chunk is started. So pred sees the groundings
+  // in the same order as in the serial case and stops at the same one, and at
+  // most one chunk of groundings is buffered.
+  template<typename T, typename UnaryFunction, typename UnaryPredicate>
+  void ForEachNewGroundingInParallel(UnaryFunction range, UnaryPredicate pred, Setup::Result* add_result) {
+    NameVectors ns(this);
+    std::vector<GroundingJob<T>> jobs;
+    auto add_jobs = [&jobs](const Ply& p, const Ungrounded<T>& u, bool delta, size_t i, const Term::Vector& names,
+                            size_t n_groundings) {
+      for (const Term n : names) {
+        jobs.push_back(GroundingJob<T>(&p, &u, delta, i, n, n_groundings / names.size()));
+      }
+    };
+    for (const Ply& p : plies(Plies::kOld)) {
+      for (const Ungrounded<T>& u : range(p)) {
+        ns.Fill(*u.plan);
+        const Term::Vector& vars = u.plan->vars();
+        for (size_t i = 0; i < vars.size(); ++i) {
+          const size_t n_groundings = nNewGroundings(u, ns, i);
+          if (n_groundings > 0) {
+            const Symbol::Sort sort = vars[0].sort();
+            add_jobs(p, u, true, i, i == 0 ? ns.new_names(sort) : ns.old_names(sort), n_groundings);
+          }
         }
       }
     }
+    const Ply& p = last_ply();
+    for (const Ungrounded<T>& u : range(p)) {
+      ns.Fill(*u.plan);
+      const Term::Vector& vars = u.plan->vars();
+      const size_t n_groundings = nGroundings(u, ns);
+      if (!vars.empty() && n_groundings > 0) {
+        add_jobs(p, u, false, 0, ns.all_names(vars[0].sort()), n_groundings);
+      } else {
+        jobs.push_back(GroundingJob<T>(&p, &u, false, 0, Term(), n_groundings));
+      }
+    }
+
+    for (size_t begin = 0, end; begin < jobs.size(); begin = end) {
+      size_t n_groundings = 0;
+      for (end = begin; end < jobs.size() && (end == begin || n_groundings < kMaxBufferedGroundings); ++end) {
+        n_groundings += jobs[end].size;
+      }
+      const size_t n_threads = std::min(n_threads_, std::max(n_groundings / kMinGroundingsPerThread, size_t(1)));
+      std::atomic<size_t> next_job(begin);
+      // Every thread has its own memo.
+      auto work = [this, &jobs, end, &ns, &next_job](Term::SubstitutionMemo* memo) {
+        Term::Factory::Context ctx(tf_);
+        for (size_t i; (i = next_job.fetch_add(1, std::memory_order_relaxed)) < end; ) {
+          GroundingJob<T>& job = jobs[i];
+          auto collect = [&job](const T& g) {
+            job.groundings.push_back(g);
+            return true;
+          };
+          if (job.delta) {
+            GroundNew(*job.u, ns, job.i, job.n, collect, memo);
+          } else {
+            Ground(*job.u, ns, 0, job.n, collect, memo);
+          }
+        }
+      };
+      std::vector<std::thread> threads;
+      for (size_t i = 1; i < n_threads; ++i) {
+        threads.emplace_back(work, memo(i));
+      }
+      work(memo(0));
+      for (std::thread& t : threads) {
+        t.join();
+      }
+
+      for (size_t i = begin; i < end; ++i) {
+        GroundingJob<T>& job = jobs[i];
+        for (const T& g : job.groundings) {
+          assert(g.ground());
+          pred(g, *job.p, add_result);
+          if (add_result && *add_result == Setup::kInconsistent) {
+            return;
+          }
+        }
+        std::vector<T>().swap(job.groundings);
+      }
+    }
+  }
+
+  // Returns the number of groundings of u.
+  template<typename T>
+  size_t nGroundings(const Ungrounded<T>& u, const NameVectors& ns) const {
+    size_t n_groundings = 1;
+    for (const Term x : u.plan->vars()) {
+      n_groundings *= ns.all_names(x.sort()).size();
+    }
+    return n_groundings;
+  }
+
+  // Returns the number of groundings of u by GroundNew() for the i-th variable.
+  template<typename T>
+  size_t nNewGroundings(const Ungrounded<T>& u, const NameVectors& ns, size_t i) const {
+    const Term::Vector& vars = u.plan->vars();
+    size_t n_groundings = 1;
+    for (size_t j = 0; j < vars.size(); ++j) {
+      const Symbol::Sort sort = vars[j].sort();
+      n_groundings *= (j < i ? ns.old_names(sort) : j > i ? ns.all_names(sort) : ns.new_names(sort)).size();
+    }
+    return n_groundings;
+  }
+
+  void CloseRelevanceUnderSetup() {
+    // In lazy mode, the relevant clauses are grounded from the relevant terms
+    // of the query. Their closure is a superset of the eager one, because the
+    // groundings are not reduced by unit propagation and subsumption yet. So
+    // the relevant clauses are copied to a new setup, which is minimized, and
+    // then the closure is computed as in eager mode.
+    // The minimized clauses only depend on the query's terms and the plies
+    // below, so they are cached in the ply below, which is not modified until
+    // the query's ply is undone or merged.
+    Ply& p = last_ply();
+    if (p.lazy) {
+      const SortedTermSet terms = p.relevant.terms;
+      std::vector<Term> key(terms.begin(), terms.end());
+      std::sort(key.begin(), key.end());
+      std::map<std::vector<Term>, std::vector<Clause>>* cache =
+          plies_.size() > 1 ? &std::next(plies_.rbegin())->lazy_setups : nullptr;
+      const std::vector<Clause>* cached = nullptr;
+      if (cache) {
+        auto it = cache->find(key);
+        cached = it != cache->end() ? &it->second : nullptr;
+      }
+      std::unique_ptr<Setup> new_s(new Setup());
+      if (cached) {
+        for (const Clause& c : *cached) {
+          new_s->AddClause(c);
+        }
+      } else {
+        relevant_queue_.assign(terms.begin(), terms.end());
+        GroundRelevantClauses([&p]() { return p.clauses.shallow_setup.setup().clauses(); }, Plies::kNew, nullptr);
+        Setup& old_s = p.clauses.shallow_setup.setup();
+        for (size_t i : old_s.clauses()) {
+          const Setup::ClauseView c = old_s.CachedClause(i);
+          if (IsRelevantClause(c, Plies::kNew)) {
+            new_s->AddClause(Clause(c));
+          }
+        }
+        new_s->Minimize();
+        if (cache) {
+          if (cache->size() >= kMaxLazySetups) {
+            cache->clear();
+          }
+          std::vector<Clause>& cs = (*cache)[std::move(key)];
+          for (size_t i : new_s->clauses()) {
+            cs.push_back(Clause(new_s->clause(i)));
+          }
+        }
+      }
+      p.clauses.shallow_setup.Kill();
+      p.clauses.full_setup = std::move(new_s);
+      p.clauses.shallow_setup = p.clauses.full_setup->shallow_copy();
+      p.relevant.terms = terms;
+    }
+    CloseRelevanceUnderClauses(p.clauses.shallow_setup.setup().clauses(), Plies::kNew);
+    relevant_queue_.clear();
+  }
+
+  void AddGrounding(const Clause& c, const Ply& p, Setup::Result* add_result) {
+    ++n_generated_clauses_;
+    if (!c.valid() && InconsistencyCheck(p, c)) {
+      const Setup::Result r = last_setup().AddClause(c);
+      n_added_clauses_ += r == Setup::kOk;
+      update_result(add_result, r);
+    }
+  }
+
+  // Grounds the clauses with variables of the old plies for the old names, so
+  // that Reground() can continue eagerly from there and the last ply's setup
+  // contains the same groundings as in eager mode.
+  void GroundDeferredClauses() {
+    Ply& last_p = last_ply();
+    assert(last_p.lazy);
+    Setup::Result add_result = Setup::kSubsumed;
+    NameVectors ns(this);
+    for (const Ply& p : plies(Plies::kOld)) {
+      for (const Ungrounded<Clause>& u : p.clauses.ungrounded) {
+        if (!u.plan->vars().empty()) {
+          ns.Fill(*u.plan);
+          const Term::Vector& vars = u.plan->vars();
+          u.plan->Ground(tf_, [&vars, &ns](size_t i) -> const Term::Vector& { return ns.old_names(vars[i].sort()); },
+                         [this, &p, &add_result](const Clause& c) {
+            AddGrounding(c, p, &add_result);
+            return true;
+          }, memo(0));
+        }
+      }
+    }
+    last_p.lazy = false;
+  }
+
+  // Grounds the clauses with variables for the terms in relevant_queue_ in
+  // lazy mode. A grounding where the left-hand side of a literal is a
+  // relevant term is relevant, so its terms become relevant as well and are
+  // queued. Once the queue is empty, the relevance is closed under the
+  // clauses r(), which may queue more terms. The old_terms have been
+  // processed before, so for them only the groundings with names from the
+  // last ply are generated.
+  template<typename ClauseRangeFunction>
+  void GroundRelevantClauses(ClauseRangeFunction r,
+                             Plies::Policy policy,
+                             Setup::Result* add_result,
+                             const std::vector<Term>& old_terms = std::vector<Term>()) {
+    struct Occurrence {
+      const Ply* p;
+      const Ungrounded<Clause>* u;
+      Term lhs;
+    };
+    std::unordered_map<Symbol, std::vector<Occurrence>> occurrences;
+    NameVectors ns(this);
+    for (const Ply& p : plies()) {
+      for (const Ungrounded<Clause>& u : p.clauses.ungrounded) {
+        if (!u.plan->vars().empty()) {
+          ns.Fill(*u.plan);
+          for (const Literal a : u.val) {
+            if (a.lhs().function()) {
+              occurrences[a.lhs().symbol()].push_back(Occurrence{&p, &u, a.lhs()});
+            }
+          }
+        }
+      }
+    }
+    Setup::Result result = Setup::kSubsumed;
+    auto ground = [this, &occurrences, &ns, policy, &result](const Term t, const bool only_new) {
+      auto it = occurrences.find(t.symbol());
+      if (it == occurrences.end()) {
+        return;
+      }
+      for (const Occurrence& o : it->second) {
+        const Term::Vector& vars = o.u->plan->vars();
+        std::vector<Term::Vector> match(vars.size());
+        if (!Match(o.lhs, t, vars, &match)) {
+          continue;
+        }
+        auto pred = [this, &o, t, policy, &result](const Clause& c) {
+          ++n_generated_clauses_;
+          if (!c.valid() && InconsistencyCheck(*o.p, c) && c.any([t](Literal a) { return a.lhs() == t; })) {
+            UpdateRelevantTerms(c, policy);
+            if (!last_setup().Subsumes(c)) {
+              const Setup::Result r = last_setup().AddClause(c);
+              n_added_clauses_ += r == Setup::kOk;
+              update_result(&result, r);
+            }
+          }
+          return result != Setup::kInconsistent;
+        };
+        // The i-th unbound variable is the first one with a new name.
+        for (size_t i = 0; i < (only_new ? vars.size() : 1); ++i) {
+          if (only_new && (!match[i].empty() || ns.new_names(vars[i].sort()).empty())) {
+            continue;
+          }
+          const bool go_on = o.u->plan->Ground(tf_, [&vars, &ns, &match, only_new, i](size_t j) -> const Term::Vector& {
+            return !match[j].empty() ? match[j] :
+                   !only_new || j > i ? ns.all_names(vars[j].sort()) :
+                   j < i              ? ns.old_names(vars[j].sort()) :
+                                        ns.new_names(vars[j].sort());
+          }, pred, memo(0));
+          if (!go_on) {
+            return;
+          }
+        }
+      }
+    };
+    for (const Term t : old_terms) {
+      ground(t, true);
+      if (result == Setup::kInconsistent) {
+        break;
+      }
+    }
+    while (result != Setup::kInconsistent) {
+      while (!relevant_queue_.empty() && result != Setup::kInconsistent) {
+        const Term t = relevant_queue_.back();
+        relevant_queue_.pop_back();
+        ground(t, false);
+      }
+      if (result == Setup::kInconsistent) {
+        break;
+      }
+      CloseRelevanceUnderClauses(r(), policy);
+      if (relevant_queue_.empty()) {
+        break;
+      }
+    }
+    relevant_queue_.clear();
+    if (add_result && result != Setup::kSubsumed) {
+      update_result(add_result, result);
+    }
+  }
+
+  // Matches the left-hand side of a literal against a ground term and stores
+  // the name for the i-th variable in (*match)[i], or returns false if they
+  // do not match. Arguments that are neither names nor variables match
+  // anything.
+  static bool Match(Term lhs, Term t, const Term::Vector& vars, std::vector<Term::Vector>* match) {
+    if (lhs.symbol() != t.symbol()) {
+      return false;
+    }
+    for (size_t k = 0; k < lhs.arity(); ++k) {
+      const Term x = lhs.arg(k);
+      const Term n = t.arg(k);
+      if (x.variable()) {
+        if (!n.name()) {
+          return false;
+        }
+        Term::Vector& m = (*match)[std::find(vars.begin(), vars.end(), x) - vars.begin()];
+        if (m.empty()) {
+          m.push_back(n);
+        } else if (m[0] != n) {
+          return false;
+        }
+      } else if (x.ground() && x != n) {
+        return false;
+      }
+    }
+    return true;
   }
 
   static void update_result(Setup::Result* add_result, Setup::Result r) {
@@ -944,31 +1626,50 @@ rescan:
     // Ground old clauses for names from last ply.
     // Ground new clauses for all names.
     // Add f(.)=n, f(.)/=n pairs from newly grounded clauses to lhs_rhs.
+    // [In lazy mode, ground only the new clauses without variables, and
+    // ground the others for the relevant terms if there is a relevance filter.]
     Setup::Result add_result = Setup::kSubsumed;
     Ply& p = last_ply();
-    ForEachNewGrounding(
-        [](const Ply& p) { return p.clauses.ungrounded; },
-        [this](const Clause& c, const Ply& p, Setup::Result* add_result) {
-          if (!c.valid() && InconsistencyCheck(p, c)) {
-            const Setup::Result r = last_setup().AddClause(c);
-            update_result(add_result, r);
-          }
-        },
-        &add_result);
+    if (!p.lazy) {
+      ForEachNewGrounding(
+          [](const Ply& p) -> const Ungrounded<Clause>::Vector& { return p.clauses.ungrounded; },
+          [this](const Clause& c, const Ply& p, Setup::Result* add_result) { AddGrounding(c, p, add_result); },
+          &add_result);
+    } else {
+      for (const Ungrounded<Clause>& u : p.clauses.ungrounded) {
+        if (u.plan->vars().empty() && (AddGrounding(u.val, p, &add_result), add_result == Setup::kInconsistent)) {
+          break;
+        }
+      }
+    }
     if (add_result == Setup::kInconsistent) {
       return add_result;
     }
     if (p.relevant.filter) {
       ForEachNewGrounding(
-          [](const Ply& p) { return p.relevant.ungrounded; },
+          [](const Ply& p) -> const Ungrounded<Term>::Set& { return p.relevant.ungrounded; },
           [this](const Term t, const Ply&, Setup::Result*) {
             UpdateRelevantTerms(t, Plies::kSinceSetup);
           });
       CloseRelevanceUnderClauses(p.clauses.shallow_setup.new_clauses(), Plies::kSinceSetup);
+      if (p.lazy) {
+        // New names lead to new groundings for the old relevant terms.
+        std::vector<Term> old_terms;
+        if (!p.names.mentioned.all_empty() || !p.names.plus_max.all_empty() || !p.names.plus_new.all_empty()) {
+          for (const Ply& q : plies(Plies::kSinceSetup)) {
+            old_terms.insert(old_terms.end(), q.relevant.terms.begin(), q.relevant.terms.end());
+          }
+        }
+        GroundRelevantClauses([&p]() { return p.clauses.shallow_setup.new_clauses(); }, Plies::kSinceSetup,
+                              &add_result, old_terms);
+        if (add_result == Setup::kInconsistent) {
+          return add_result;
+        }
+      }
       std::vector<Clause> new_clauses;
       Setup& s = last_setup();
       for (size_t i : p.clauses.shallow_setup.new_clauses()) {
-        new_clauses.push_back(s.clause(i));
+        new_clauses.push_back(Clause(s.CachedClause(i)));
       }
       p.clauses.shallow_setup.Kill();
       p.clauses.shallow_setup = s.shallow_copy();
@@ -986,10 +1687,10 @@ rescan:
       p.clauses.shallow_setup.Minimize();
     }
     for (size_t i : p.clauses.shallow_setup.new_clauses()) {
-      UpdateLhsRhs(last_setup().clause(i), Plies::kSinceSetup);
+      UpdateLhsRhs(last_setup().CachedClause(i), Plies::kSinceSetup);
     }
     ForEachNewGrounding(
-        [](const Ply& p) { return p.lhs_rhs.ungrounded; },
+        [](const Ply& p) -> const Ungrounded<Literal>::Set& { return p.lhs_rhs.ungrounded; },
         [this](const Literal a, const Ply&, Setup::Result*) {
           UpdateLhsRhs(a, Plies::kSinceSetup);
         });
@@ -1002,13 +1703,13 @@ rescan:
     assert(p.relevant.filter);
     assert(p.clauses.ungrounded.empty());
     assert(p.names.mentioned.all_empty() && p.names.plus_new.all_empty() && p.names.plus_max.all_empty());
-    const Setup& old_s = p.clauses.shallow_setup.setup();
+    Setup& old_s = p.clauses.shallow_setup.setup();
     std::unique_ptr<Setup> new_s(new Setup());
     for (size_t i : old_s.clauses()) {
-      const Clause c = old_s.clause(i);
+      const Setup::ClauseView c = old_s.CachedClause(i);
       if (IsRelevantClause(c, Plies::kNew)) {
         UpdateLhsRhs(c, Plies::kNew);
-        new_s->AddClause(c);
+        new_s->AddClause(Clause(c));
       }
     }
     if (minimize) {
@@ -1062,12 +1763,24 @@ rescan:
       p->clauses.full_setup->Minimize();
       p->clauses.shallow_setup = p->clauses.full_setup->shallow_copy();
     }
+    p->lazy_setups.clear();
     plies_.erase(plies_.begin(), p);
     plies_.erase(std::next(p), plies_.end());
     assert(plies_.size() == 1);
   }
 
+  static constexpr size_t kMinGroundingsPerThread = 1024;
+  static constexpr size_t kMaxBufferedGroundings = 1 << 16;
+  static constexpr size_t kMaxLazySetups = 256;
+
   Term::Factory* const tf_;
+  size_t n_threads_ = 1;
+  size_t memo_slots_ = 0;
+  mutable std::vector<std::unique_ptr<Term::SubstitutionMemo>> memos_;
+  bool lazy_ = false;
+  std::vector<Term> relevant_queue_;
+  size_t n_generated_clauses_ = 0;
+  size_t n_added_clauses_ = 0;
   NamePool name_pool_;
   VariablePool var_pool_;
   Ply::List plies_;
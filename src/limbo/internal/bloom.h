@@ -9,55 +9,96 @@
 // This implementation is designed for small sets and specifically intended
 // for clauses.
 //
-// Let m = 64 the size of the bitmask.
+// Let m be the size of the bitmask, which is 64, 128, or 256 bits.
 // Let k be the number of hash functions.
 // Let n be the expected number of entries.
 //
 // The optimal n for given m and k is (m / n) * ln 2. (Says Wikipedia.)
 //
 // Supposing most clauses don't have more than 10 entries, 4 or 5 hash
-// functions should be fine.
+// functions should be fine for m = 64. Longer clauses saturate a 64-bit
+// mask quickly, which is what the wider masks are for. The default width
+// is given by LIMBO_BLOOM_BITS. The wider masks are GCC vector types, so
+// that union, intersection, and subset tests are SIMD operations; they are
+// only 8-byte aligned so that clauses can live in ordinary containers.
 //
-// We take the byte pairs 1,2 and 3,4 and 5,6 and 7,8 and consider the 16bit
-// number formed by each of them as a single hash.
+// We take the bytes 1, 2, 3, 4 of the hash and consider the log_2(m) lowest
+// bits of each of them as a single hash.
+//
+// BloomStats counts how often a filter query was positive and how often the
+// exact check that followed showed that it was a false positive. Callers
+// report the exact result with BloomStats::Record(), which only evaluates the
+// exact check when LIMBO_BLOOM_STATS is defined.
 
 #ifndef LIMBO_INTERNAL_BLOOM_H_
 #define LIMBO_INTERNAL_BLOOM_H_
 
+#include <atomic>
 #include <functional>
 
 #include <limbo/internal/hash.h>
 #include <limbo/internal/ints.h>
 
+#ifndef LIMBO_BLOOM_BITS
+#define LIMBO_BLOOM_BITS 64
+#endif
+
 namespace limbo {
 namespace internal {
 
+template<size_t Bits>
+struct BloomMask;
+
+template<>
+struct BloomMask<64> {
+  typedef u64 type;
+  static void Set(type* m, size_t i) { *m |= static_cast<u64>(1) << i; }
+  static bool Zero(const type m) { return m == 0; }
+};
+
+#ifdef __GNUC__
+template<>
+struct BloomMask<128> {
+  typedef u64 type __attribute__((vector_size(16), aligned(8)));
+  static void Set(type* m, size_t i) { (*m)[i / 64] |= static_cast<u64>(1) << (i % 64); }
+  static bool Zero(const type m) { return (m[0] | m[1]) == 0; }
+};
+
+template<>
+struct BloomMask<256> {
+  typedef u64 type __attribute__((vector_size(32), aligned(8)));
+  static void Set(type* m, size_t i) { (*m)[i / 64] |= static_cast<u64>(1) << (i % 64); }
+  static bool Zero(const type m) { return (m[0] | m[1] | m[2] | m[3]) == 0; }
+};
+#endif
+
+template<size_t Bits = LIMBO_BLOOM_BITS>
 class BloomFilter {
  public:
+  static_assert(Bits == 64 || Bits == 128 || Bits == 256, "BloomFilter width must be 64, 128, or 256");
+
   BloomFilter() = default;
 
   static BloomFilter Union(const BloomFilter a, const BloomFilter b)        { return BloomFilter(a.mask_ | b.mask_); }
   static BloomFilter Intersection(const BloomFilter a, const BloomFilter b) { return BloomFilter(a.mask_ & b.mask_); }
 
-  bool operator==(const BloomFilter b) const { return mask_ == b.mask_; }
+  bool operator==(const BloomFilter b) const { return Mask::Zero(mask_ ^ b.mask_); }
   bool operator!=(const BloomFilter b) const { return !(*this == b); }
 
-  void Clear() { mask_ = 0; }
+  void Clear() { mask_ = mask_t{}; }
 
   template<typename HashType>
   void Add(const HashType x) {
-    mask_ |= (static_cast<mask_t>(1) << index<0>(x))
-          |  (static_cast<mask_t>(1) << index<1>(x))
-          |  (static_cast<mask_t>(1) << index<2>(x))
-          |  (static_cast<mask_t>(1) << index<3>(x));
+    mask_t m;
+    bits(x, &m);
+    mask_ |= m;
   }
 
   template<typename HashType>
   bool Contains(const HashType x) const {
-    return (( (mask_ >> index<0>(x))
-            & (mask_ >> index<1>(x))
-            & (mask_ >> index<2>(x))
-            & (mask_ >> index<3>(x))) & static_cast<mask_t>(1)) != 0;
+    mask_t m;
+    bits(x, &m);
+    return Mask::Zero(m & ~mask_);
   }
 
   void Union(const BloomFilter& b)     { mask_ |= b.mask_; }
@@ -66,24 +107,26 @@ class BloomFilter {
   bool SubsetOf(const BloomFilter& b) const { return Subset(*this, b); }
   bool Overlaps(const BloomFilter& b) const { return Overlap(*this, b); }
 
-  static bool Subset(const BloomFilter& a, const BloomFilter& b)  { return ~(~a.mask_ | b.mask_) == 0; }
-  static bool Overlap(const BloomFilter& a, const BloomFilter& b) { return (a.mask_ & b.mask_) != 0; }
+  static bool Subset(const BloomFilter& a, const BloomFilter& b)  { return Mask::Zero(a.mask_ & ~b.mask_); }
+  static bool Overlap(const BloomFilter& a, const BloomFilter& b) { return !Mask::Zero(a.mask_ & b.mask_); }
 
  private:
 #ifdef FRIEND_TEST
   FRIEND_TEST(BloomFilterTest, hash);
+  FRIEND_TEST(BloomFilterTest, wide_hash);
 #endif
 
+  typedef BloomMask<Bits> Mask;
   typedef internal::u64 bit_index_t;
-  typedef internal::u64 mask_t;
+  typedef typename Mask::type mask_t;
 
   explicit BloomFilter(const mask_t& mask) : mask_(mask) {}
 
   template<size_t I, typename HashType>
   static bit_index_t index(HashType x) {
     // index() should slice the original HashType x into several bit_index_t,
-    // whose range shall be [0 ... bits(mask_t) - 1], that is, the indices
-    // of the bits in mask_t.
+    // whose range shall be [0 ... Bits - 1], that is, the indices of the bits
+    // in mask_t.
     //
     // When mask_t is a 64 bit integer, we just need log_2(64) = 6 bits for
     // an index. So we can do is take the Ith byte and return its value
@@ -92,26 +135,39 @@ class BloomFilter {
     // return ((x >> (I*8)) & 0xFF) % (sizeof(mask_t) * 8);
     //
     // But since 63 is just binary 111111, we can simply take the six
-    // right-most bits of the byte:
-    constexpr bit_index_t kMaxIndex = 63;
-    static_assert((~static_cast<HashType>(0) & kMaxIndex) != 0, "HashType does not provide enough bits");
-    static_assert((~static_cast<mask_t>(0) >> kMaxIndex) == 1, "mask does not cover mask_t indices");
+    // right-most bits of the byte. Analogously, 128 and 256 bits take the
+    // seven and eight right-most bits.
+    constexpr bit_index_t kMaxIndex = Bits - 1;
+    static_assert(((~static_cast<HashType>(0) >> (I*8)) & kMaxIndex) == kMaxIndex,
+                  "HashType does not provide enough bits");
+    static_assert(kMaxIndex <= 0xFF, "index does not fit in a byte");
     return (x >> (I*8)) & kMaxIndex;
   }
 
-  mask_t mask_ = 0;
+  template<typename HashType>
+  static void bits(const HashType x, mask_t* m) {
+    *m = mask_t{};
+    Mask::Set(m, index<0>(x));
+    Mask::Set(m, index<1>(x));
+    Mask::Set(m, index<2>(x));
+    Mask::Set(m, index<3>(x));
+  }
+
+  mask_t mask_{};
 };
 
-template<typename T>
+template<typename T, size_t Bits = LIMBO_BLOOM_BITS>
 class BloomSet {
  public:
+  typedef BloomFilter<Bits> Filter;
+
   BloomSet() = default;
 
   static BloomSet Union(const BloomSet& a, const BloomSet& b) {
-    return BloomSet(BloomFilter::Union(a.bf_, b.bf_));
+    return BloomSet(Filter::Union(a.bf_, b.bf_));
   }
   static BloomSet Intersection(const BloomSet& a, const BloomSet& b) {
-    return BloomSet(BloomFilter::Intersection(a.bf_, b.bf_));
+    return BloomSet(Filter::Intersection(a.bf_, b.bf_));
   }
 
   bool operator==(const BloomSet& b) const { return bf_ == b.bf_; }
@@ -124,12 +180,62 @@ class BloomSet {
 
   bool PossiblyContains(const T& x)        const { return bf_.Contains(x.hash()); }
   bool PossiblySubsetOf(const BloomSet& b) const { return bf_.SubsetOf(b.bf_); }
-  bool PossiblyOverlaps(const BloomSet& b) const { return bf_.Overlaps(b.bf_); }
 
  private:
-  explicit BloomSet(const BloomFilter& bf) : bf_(bf) {}
+  explicit BloomSet(const Filter& bf) : bf_(bf) {}
 
-  BloomFilter bf_;
+  Filter bf_;
+};
+
+class BloomStats {
+ public:
+  enum Query { kContains, kSubsetOf, kQueries };
+
+#ifdef LIMBO_BLOOM_STATS
+  static constexpr bool kEnabled = true;
+#else
+  static constexpr bool kEnabled = false;
+#endif
+
+  static BloomStats* Instance() {
+    static BloomStats instance;
+    return &instance;
+  }
+
+  // Record() is to be called after a PossiblyContains(), PossiblySubsetOf(),
+  // or PossiblyOverlaps() query returned true; exact() shall return the
+  // actual answer to the query.
+  template<typename ExactCheck>
+  static void Record(const Query q, ExactCheck exact) {
+    if (kEnabled) {
+      BloomStats* s = Instance();
+      s->positives_[q].fetch_add(1, std::memory_order_relaxed);
+      if (!exact()) {
+        s->false_positives_[q].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  BloomStats(const BloomStats&) = delete;
+  BloomStats& operator=(const BloomStats&) = delete;
+  BloomStats(BloomStats&&) = delete;
+  BloomStats& operator=(BloomStats&&) = delete;
+
+  u64 positives(const Query q)       const { return positives_[q].load(std::memory_order_relaxed); }
+  u64 false_positives(const Query q) const { return false_positives_[q].load(std::memory_order_relaxed); }
+
+  void Reset() {
+    for (size_t q = 0; q < kQueries; ++q) {
+      positives_[q].store(0, std::memory_order_relaxed);
+      false_positives_[q].store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  BloomStats() { Reset(); }
+
+  std::atomic<u64> positives_[kQueries];
+  std::atomic<u64> false_positives_[kQueries];
 };
 
 }  // namespace internal
@@ -138,17 +244,20 @@ class BloomSet {
 
 namespace std {
 
-template<>
-struct equal_to<limbo::internal::BloomFilter> {
-  bool operator()(const limbo::internal::BloomFilter& a, const limbo::internal::BloomFilter& b) const { return a == b; }
+template<size_t Bits>
+struct equal_to<limbo::internal::BloomFilter<Bits>> {
+  bool operator()(const limbo::internal::BloomFilter<Bits>& a, const limbo::internal::BloomFilter<Bits>& b) const {
+    return a == b;
+  }
 };
 
-template<typename T>
-struct equal_to<limbo::internal::BloomSet<T>> {
-  bool operator()(const limbo::internal::BloomSet<T>& a, const limbo::internal::BloomSet<T>& b) const { return a == b; }
+template<typename T, size_t Bits>
+struct equal_to<limbo::internal::BloomSet<T, Bits>> {
+  bool operator()(const limbo::internal::BloomSet<T, Bits>& a, const limbo::internal::BloomSet<T, Bits>& b) const {
+    return a == b;
+  }
 };
 
 }  // namespace std
 
 #endif  // LIMBO_INTERNAL_BLOOM_H_
-
@@ -2,11 +2,15 @@
 // Copyright 2016-2017 Christoph Schwering
 // Licensed under the MIT license. See LICENSE file in the project root.
 //
-// Some fast hash functions.
+// Some fast hash functions. MurmurHash2() and murmur64a_hash() hash the bytes
+// of an object; murmur3_combine() and murmur3_finalize() hash sequences of
+// values, such as the arguments of a term or the literals of a clause.
 
 #ifndef LIMBO_INTERNAL_HASH_H_
 #define LIMBO_INTERNAL_HASH_H_
 
+#include <cstring>
+
 #include <limbo/internal/ints.h>
 
 namespace limbo {
@@ -39,17 +43,18 @@ hash64_t fnv1a_hash(const T& x, hash64_t seed = 0) {
 }
 
 template<typename T>
-u32 MurmurHash2(const T& x, u32 seed ) {
+u32 MurmurHash2(const T& x, u32 seed) {
   // MurmurHash (32bit hash) by Austin Appleby (public domain).
   const u32 m = 0x5bd1e995;
   const int r = 24;
   u32 h = seed ^ sizeof(x);
 
-  const u64* data = (const u64 *)reinterpret_cast<const u64*>(&x);
+  const u8* data = reinterpret_cast<const u8*>(&x);
   size_t len = sizeof(x);
 
-  while (sizeof(x) >= 4) {
-    u32 k = *(u32*) data;
+  while (len >= 4) {
+    u32 k;
+    std::memcpy(&k, data, sizeof(k));
 
     k *= m;
     k ^= k >> r;
@@ -63,9 +68,9 @@ u32 MurmurHash2(const T& x, u32 seed ) {
   }
 
   switch (len) {
-    case 3: h ^= data[2] << 16;
-    case 2: h ^= data[1] << 8;
-    case 1: h ^= data[0];
+    case 3: h ^= static_cast<u32>(data[2]) << 16;
+    case 2: h ^= static_cast<u32>(data[1]) << 8;
+    case 1: h ^= static_cast<u32>(data[0]);
             h *= m;
   }
 
@@ -81,14 +86,16 @@ hash64_t murmur64a_hash(const T& x, hash64_t seed = 0) {
   const hash64_t m = 0xc6a4a7935bd1e995;
   const int r = 47;
 
-  const u64* data = (const u64 *)reinterpret_cast<const u64*>(&x);
+  const u8* data = reinterpret_cast<const u8*>(&x);
   const size_t len = sizeof(x);
-  const u64* end = data + (len / 8);
+  const u8* end = data + (len / 8) * 8;
 
   hash64_t h = seed ^ (len * m);
 
   while (data != end) {
-    u64 k = *data++;
+    u64 k;
+    std::memcpy(&k, data, sizeof(k));
+    data += 8;
 
     k *= m;
     k ^= k >> r;
@@ -115,6 +122,31 @@ hash64_t murmur64a_hash(const T& x, hash64_t seed = 0) {
   return h;
 }
 
+// Incremental hashing of sequences of 32bit values, following the block and
+// finalization steps of MurmurHash3 by Austin Appleby (public domain). Unlike
+// XOR, the combination depends on the order of the values, and the finalizer
+// spreads every input bit over the whole hash, so that the lower and upper
+// bits are equally usable as table index. A sequence v1,...,vn is hashed as
+//   murmur3_finalize(murmur3_combine(...murmur3_combine(seed, v1)..., vn), n).
+inline hash32_t murmur3_combine(hash32_t h, u32 k) {
+  k *= 0xcc9e2d51;
+  k = (k << 15) | (k >> 17);
+  k *= 0x1b873593;
+  h ^= k;
+  h = (h << 13) | (h >> 19);
+  return h * 5 + 0xe6546b64;
+}
+
+inline hash32_t murmur3_finalize(hash32_t h, u32 len) {
+  h ^= len;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
 }  // namespace internal
 }  // namespace limbo
 
@@ -0,0 +1,235 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Pool<T> allocates arrays of T whose capacities are rounded up to a power of
+// two, called their size class. Released arrays are kept in a free list per
+// size class and thread and are handed out again by the next allocation of the
+// same class. This is meant for the overflow literals of clauses, which are
+// created and destroyed in large numbers during grounding and solving. Arrays
+// with more than kMaxPooled elements bypass the free lists, and a free list
+// retains at most kMaxRetainedBytes; further releases of that class go back to
+// the global allocator.
+//
+// An array may be released by a different thread than the one which allocated
+// it; it then ends up in the releasing thread's free list. Hence a thread that
+// only releases arrays allocated elsewhere holds on to at most kClasses times
+// kMaxRetainedBytes. The free lists of a thread are emptied when the thread
+// terminates.
+//
+// Pool does not run constructors or destructors, so T must be trivial, and it
+// must be large enough to hold the free list link.
+//
+// PoolStats counts how many arrays were allocated, how many of them came from
+// a free list, how many bytes the free lists of all threads currently retain,
+// and the sizes of the objects on whose behalf they were requested. It only
+// counts when LIMBO_POOL_STATS is defined.
+
+#ifndef LIMBO_INTERNAL_POOL_H_
+#define LIMBO_INTERNAL_POOL_H_
+
+#include <cassert>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+class PoolStats {
+ public:
+  static constexpr size_t kSizes = 64;
+
+#ifdef LIMBO_POOL_STATS
+  static constexpr bool kEnabled = true;
+#else
+  static constexpr bool kEnabled = false;
+#endif
+
+  static PoolStats* Instance() {
+    static PoolStats instance;
+    return &instance;
+  }
+
+  // RecordSize() is to be called by the owner of the arrays for each object
+  // it creates, so that sizes(n) tells how many objects of size n (or at least
+  // kSizes - 1 in the last bucket) existed.
+  static void RecordSize(size_t n) {
+    if (kEnabled) {
+      Instance()->sizes_[n < kSizes ? n : kSizes - 1].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  static void RecordAllocation(bool reused) {
+    if (kEnabled) {
+      PoolStats* s = Instance();
+      s->allocations_.fetch_add(1, std::memory_order_relaxed);
+      if (reused) {
+        s->reuses_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // RecordRetained() is called with the positive or negative number of bytes
+  // that enter or leave a free list. Unlike the other counters, retained() is
+  // a current amount and is therefore not affected by Reset().
+  static void RecordRetained(i64 bytes) {
+    if (kEnabled) {
+      Instance()->retained_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+  }
+
+  PoolStats(const PoolStats&) = delete;
+  PoolStats& operator=(const PoolStats&) = delete;
+  PoolStats(PoolStats&&) = delete;
+  PoolStats& operator=(PoolStats&&) = delete;
+
+  u64 allocations()      const { return allocations_.load(std::memory_order_relaxed); }
+  u64 reuses()           const { return reuses_.load(std::memory_order_relaxed); }
+  i64 retained()         const { return retained_.load(std::memory_order_relaxed); }
+  u64 sizes(size_t n)    const { return sizes_[n < kSizes ? n : kSizes - 1].load(std::memory_order_relaxed); }
+
+  void Reset() {
+    allocations_.store(0, std::memory_order_relaxed);
+    reuses_.store(0, std::memory_order_relaxed);
+    for (size_t n = 0; n < kSizes; ++n) {
+      sizes_[n].store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  PoolStats() { Reset(); }
+
+  std::atomic<u64> allocations_;
+  std::atomic<u64> reuses_;
+  std::atomic<i64> retained_{0};
+  std::atomic<u64> sizes_[kSizes];
+};
+
+template<typename T>
+class Pool {
+ public:
+  static constexpr size_t kClasses = 8;
+  static constexpr size_t kMaxPooled = static_cast<size_t>(1) << (kClasses - 1);
+  static constexpr size_t kMaxRetainedBytes = 64 * 1024;
+
+  // Returns the capacity of the array that is allocated for n elements.
+  static size_t Capacity(size_t n) {
+    if (n > kMaxPooled) {
+      return n;
+    }
+    size_t c = 1;
+    while (c < n) {
+      c <<= 1;
+    }
+    return c;
+  }
+
+  // Allocates an array of the given capacity, which must be the result of
+  // Capacity().
+  static T* Allocate(size_t capacity) {
+    assert(capacity == Capacity(capacity));
+    if (capacity <= kMaxPooled) {
+      FreeLists* fl = free_lists();
+      const size_t k = SizeClass(capacity);
+      Link*& head = fl->heads[k];
+      if (head) {
+        Link* l = head;
+        head = l->next;
+        --fl->lengths[k];
+        PoolStats::RecordAllocation(true);
+        PoolStats::RecordRetained(-static_cast<i64>(capacity * sizeof(T)));
+        return reinterpret_cast<T*>(l);
+      }
+    }
+    PoolStats::RecordAllocation(false);
+    return static_cast<T*>(::operator new(capacity * sizeof(T)));
+  }
+
+  // Releases an array allocated with the given capacity.
+  static void Release(T* p, size_t capacity) {
+    assert(capacity == Capacity(capacity));
+    FreeLists* fl = free_lists();
+    const size_t k = capacity <= kMaxPooled ? SizeClass(capacity) : kClasses;
+    if (k == kClasses || fl->closed || fl->lengths[k] >= MaxRetained(capacity)) {
+      ::operator delete(p);
+      return;
+    }
+    static thread_local Drain drain;
+    static_cast<void>(drain);
+    Link* l = reinterpret_cast<Link*>(p);
+    Link*& head = fl->heads[k];
+    l->next = head;
+    head = l;
+    ++fl->lengths[k];
+    PoolStats::RecordRetained(capacity * sizeof(T));
+  }
+
+  // Returns how many arrays of the given capacity a free list retains.
+  static size_t MaxRetained(size_t capacity) { return kMaxRetainedBytes / (capacity * sizeof(T)); }
+
+ private:
+  static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                "Pool does not construct or destroy its elements");
+
+  struct Link {
+    Link* next;
+  };
+
+  static_assert(sizeof(T) >= sizeof(Link), "T cannot hold a free list link");
+
+  // FreeLists is trivial, so it remains accessible while the thread's other
+  // thread-local objects are destroyed; after Drain has run, releases go
+  // straight to the global allocator.
+  struct FreeLists {
+    Link* heads[kClasses];
+    size_t lengths[kClasses];
+    bool closed;
+  };
+
+  struct Drain {
+    ~Drain() {
+      FreeLists* fl = free_lists();
+      for (size_t k = 0; k < kClasses; ++k) {
+        while (fl->heads[k]) {
+          Link* l = fl->heads[k];
+          fl->heads[k] = l->next;
+          ::operator delete(l);
+        }
+        PoolStats::RecordRetained(-static_cast<i64>(fl->lengths[k] * (static_cast<size_t>(1) << k) * sizeof(T)));
+        fl->lengths[k] = 0;
+      }
+      fl->closed = true;
+    }
+  };
+
+  static FreeLists* free_lists() {
+    static thread_local FreeLists lists;
+    return &lists;
+  }
+
+  static size_t SizeClass(size_t capacity) {
+    size_t k = 0;
+    while ((static_cast<size_t>(1) << k) < capacity) {
+      ++k;
+    }
+    return k;
+  }
+};
+
+template<typename T>
+constexpr size_t Pool<T>::kClasses;
+
+template<typename T>
+constexpr size_t Pool<T>::kMaxPooled;
+
+template<typename T>
+constexpr size_t Pool<T>::kMaxRetainedBytes;
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_POOL_H_
@@ -0,0 +1,128 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+// Licensed under the MIT license. See LICENSE file in the project root.
+//
+// Vectorized kernels on the bit representation of primitive literals, which
+// is defined in the Literal class: the lhs id in the lower 32 bits, the rhs id
+// in the next 31 bits, and the sign in the highest bit.
+//
+// SubsumesAny(as, m, bs, n, out) tests for every as[i] whether it subsumes
+// any of bs[0], ..., bs[n-1]. The vectorized variants test four (AVX2) or two
+// (SSE4.1) literals of as at once against each literal of bs. The best variant
+// supported by the CPU is chosen at runtime; on other platforms or compilers,
+// including Emscripten, only the scalar variant exists.
+
+#ifndef LIMBO_INTERNAL_SIMD_H_
+#define LIMBO_INTERNAL_SIMD_H_
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+#define LIMBO_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include <limbo/internal/ints.h>
+
+namespace limbo {
+namespace internal {
+
+typedef void (*SubsumesAnyFunction)(const u64* as, size_t m, const u64* bs, size_t n, bool* out);
+
+constexpr u64 kLhsBits = 0x00000000FFFFFFFFull;
+constexpr u64 kRhsBits = 0x7FFFFFFF00000000ull;
+constexpr u64 kPosBit  = 0x8000000000000000ull;
+
+// Mirrors Literal::Subsumes() for primitive literals.
+inline bool SubsumesBits(u64 a, u64 b) {
+  const u64 x = a ^ b;
+  return x == 0 || ((x & kLhsBits) == 0 && (x & kRhsBits) != 0 && (a & kPosBit) != 0 && (b & kPosBit) == 0);
+}
+
+inline void SubsumesAnyScalar(const u64* as, size_t m, const u64* bs, size_t n, bool* out) {
+  for (size_t i = 0; i < m; ++i) {
+    bool r = false;
+    for (size_t j = 0; j < n && !r; ++j) {
+      r = SubsumesBits(as[i], bs[j]);
+    }
+    out[i] = r;
+  }
+}
+
+#ifdef LIMBO_SIMD_X86
+__attribute__((target("sse4.1")))
+inline void SubsumesAnySse41(const u64* as, size_t m, const u64* bs, size_t n, bool* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lhs = _mm_set1_epi64x(static_cast<long long>(kLhsBits));
+  const __m128i rhs = _mm_set1_epi64x(static_cast<long long>(kRhsBits));
+  const __m128i pos = _mm_set1_epi64x(static_cast<long long>(kPosBit));
+  size_t i = 0;
+  for (; i + 2 <= m; i += 2) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(as + i));
+    const __m128i a_pos = _mm_cmpeq_epi64(_mm_and_si128(a, pos), pos);
+    __m128i r = zero;
+    for (size_t j = 0; j < n; ++j) {
+      const __m128i x = _mm_xor_si128(a, _mm_set1_epi64x(static_cast<long long>(bs[j])));
+      r = _mm_or_si128(r, _mm_cmpeq_epi64(x, zero));
+      if ((bs[j] & kPosBit) == 0) {
+        const __m128i lhs_eq = _mm_cmpeq_epi64(_mm_and_si128(x, lhs), zero);
+        const __m128i rhs_eq = _mm_cmpeq_epi64(_mm_and_si128(x, rhs), zero);
+        r = _mm_or_si128(r, _mm_and_si128(_mm_andnot_si128(rhs_eq, lhs_eq), a_pos));
+      }
+    }
+    const int mask = _mm_movemask_pd(_mm_castsi128_pd(r));
+    out[i + 0] = (mask & 1) != 0;
+    out[i + 1] = (mask & 2) != 0;
+  }
+  SubsumesAnyScalar(as + i, m - i, bs, n, out + i);
+}
+
+__attribute__((target("avx2")))
+inline void SubsumesAnyAvx2(const u64* as, size_t m, const u64* bs, size_t n, bool* out) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i lhs = _mm256_set1_epi64x(static_cast<long long>(kLhsBits));
+  const __m256i rhs = _mm256_set1_epi64x(static_cast<long long>(kRhsBits));
+  const __m256i pos = _mm256_set1_epi64x(static_cast<long long>(kPosBit));
+  size_t i = 0;
+  for (; i + 4 <= m; i += 4) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(as + i));
+    const __m256i a_pos = _mm256_cmpeq_epi64(_mm256_and_si256(a, pos), pos);
+    __m256i r = zero;
+    for (size_t j = 0; j < n; ++j) {
+      const __m256i x = _mm256_xor_si256(a, _mm256_set1_epi64x(static_cast<long long>(bs[j])));
+      r = _mm256_or_si256(r, _mm256_cmpeq_epi64(x, zero));
+      if ((bs[j] & kPosBit) == 0) {
+        const __m256i lhs_eq = _mm256_cmpeq_epi64(_mm256_and_si256(x, lhs), zero);
+        const __m256i rhs_eq = _mm256_cmpeq_epi64(_mm256_and_si256(x, rhs), zero);
+        r = _mm256_or_si256(r, _mm256_and_si256(_mm256_andnot_si256(rhs_eq, lhs_eq), a_pos));
+      }
+    }
+    const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(r));
+    for (size_t k = 0; k < 4; ++k) {
+      out[i + k] = (mask & (1 << k)) != 0;
+    }
+  }
+  SubsumesAnySse41(as + i, m - i, bs, n, out + i);
+}
+#endif
+
+inline SubsumesAnyFunction BestSubsumesAny() {
+#ifdef LIMBO_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SubsumesAnyAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return SubsumesAnySse41;
+  }
+#endif
+  return SubsumesAnyScalar;
+}
+
+inline void SubsumesAny(const u64* as, size_t m, const u64* bs, size_t n, bool* out) {
+  static const SubsumesAnyFunction f = BestSubsumesAny();
+  f(as, m, bs, n, out);
+}
+
+}  // namespace internal
+}  // namespace limbo
+
+#endif  // LIMBO_INTERNAL_SIMD_H_
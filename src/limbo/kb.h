@@ -22,6 +22,10 @@
 //
 // Queries are not subject to any syntactic restrictions. Technically, they are
 // evaluated using variants of Levesque's representation theorem.
+//
+// Add() and Entails() resolve terms with the Term::Factory given to the
+// constructor, so that knowledge bases with separate factories are isolated
+// from each other. The same holds for the queries of a Solver.
 
 #ifndef LIMBO_KB_H_
 #define LIMBO_KB_H_
@@ -62,11 +66,13 @@ class KnowledgeBase {
   KnowledgeBase& operator=(KnowledgeBase&&) = default;
 
   void Add(const Clause& c) {
+    Term::Factory::Context ctx(tf_);
     knowledge_.push_back(c);
     c.Traverse([this](Term t) { if (t.name()) names_.insert(t); return true; });
   }
 
   bool Add(const Formula& alpha) {
+    Term::Factory::Context ctx(tf_);
     Formula::Ref beta = alpha.NF(sf_, tf_, false);
     bool assume_consistent = false;
     if (beta->type() == Formula::kGuarantee) {
@@ -93,6 +99,7 @@ class KnowledgeBase {
   }
 
   bool Entails(const Formula& sigma, bool distribute = true) {
+    Term::Factory::Context ctx(tf_);
     assert(sigma.subjective());
     assert(sigma.free_vars().all_empty());
     UpdateSpheres();
@@ -132,6 +139,7 @@ class KnowledgeBase {
     if (n_processed_beliefs_ == beliefs_.size() && n_processed_knowledge_ == knowledge_.size()) {
       return;
     }
+    Term::Factory::Context ctx(tf_);
     if (beliefs_.empty()) {
       assert(spheres_.size() == 1);
       assert(n_processed_beliefs_ == 0);
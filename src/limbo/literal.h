@@ -10,7 +10,8 @@
 // which are only defined for primitive literals. Note that the operations
 // PropagateUnit() and Subsumes() from the Clause class use hashing to speed
 // them up and therefore depend on their inner workings. In other words: when
-// you modify them, double-check with the Clause class.
+// you modify them, double-check with the Clause class. The same holds for the
+// vectorized SubsumesAny(), which works on the bit representation.
 //
 // Due to the memory-wise lightweight representation of terms, copying or
 // comparing literals is very fast.
@@ -26,8 +27,10 @@
 
 #include <limbo/term.h>
 
+#include <limbo/internal/hash.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/maybe.h>
+#include <limbo/internal/simd.h>
 
 namespace limbo {
 
@@ -62,8 +65,8 @@ class Literal {
   static Literal Min(Term lhs) { return Literal(lhs); }
 
   internal::hash32_t hash() const {
-    return internal::jenkins_hash(static_cast<u32>(data_ >> 32)) ^
-           internal::jenkins_hash(static_cast<u32>(data_));
+    const internal::hash32_t h = internal::murmur3_combine(0, static_cast<u32>(data_ >> 32));
+    return internal::murmur3_finalize(internal::murmur3_combine(h, static_cast<u32>(data_)), 2);
   }
 
   // valid() holds for (t = t) and (n1 != n2) and (t1 != t2) if t1, t2 have different sorts.
@@ -112,6 +115,15 @@ class Literal {
     return Subsumes(*this, b);
   }
 
+  // SubsumesAny(as, m, bs, n, out) sets out[i] to true iff as[i] subsumes some
+  // of bs[0], ..., bs[n-1], for all i < m. It is vectorized where possible.
+  static void SubsumesAny(const Literal* as, size_t m, const Literal* bs, size_t n, bool* out) {
+    assert(std::all_of(as, as + m, [](Literal a) { return a.primitive(); }));
+    assert(std::all_of(bs, bs + n, [](Literal b) { return b.primitive(); }));
+    static_assert(sizeof(Literal) == sizeof(u64), "Literal must consist of a u64 only");
+    internal::SubsumesAny(reinterpret_cast<const u64*>(as), m, reinterpret_cast<const u64*>(bs), n, out);
+  }
+
   template<typename UnaryFunction>
   Literal Substitute(UnaryFunction theta, Term::Factory* tf) const {
     return Literal(pos(), lhs().Substitute(theta, tf), rhs().Substitute(theta, tf));
@@ -14,13 +14,18 @@
 // Additionally, ShallowCopy() can be used to add further clauses or unit
 // clauses which are automatically removed once the lifecycle of ShallowCopy
 // ends. This allows for very cheap backtracking. Note that anything that is
-// added to a ShallowCopy also occurs in the original Setup. During the
-// lifecycle of any ShallowCopies, Minimize() must not be called, as it leads
-// to undefined behaviour.
+// added to a ShallowCopy also occurs in the original Setup. Minimize() may
+// also be called on a Setup or ShallowCopy while other ShallowCopies are
+// alive; once these are killed, the setup is restored as described below.
+// The new_clauses() of a ShallowCopy are however meaningless after an
+// enclosing Setup or ShallowCopy was minimized, until it is killed.
 //
 // Subsumes() checks whether the clause is subsumed by any clause in the setup
 // after doing unit propagation; it is hence a sound but incomplete test for
-// entailment.
+// entailment. Conversely, ForEachSubsumed() enumerates the clauses of the
+// setup that are subsumed by a given clause. Both are indexed: the former
+// only tests clauses whose first watched literal's lhs occurs in the clause,
+// the latter only tests clauses from the occurrence list of one of its lhs.
 //
 // Determines() returns for a given term t a name n such that the setup
 // entails [t=n], if such a name exists. In case the setup contains the empty
@@ -31,7 +36,9 @@
 // consistency checks. The former only investigates clauses that share a one
 // of a given set of primitive terms. Typically one wants this set of terms
 // to be transitively closed under the terms occurring in setup clauses. It
-// is the users responsibility to make sure this condition holds.
+// is the users responsibility to make sure this condition holds. The setup
+// tracks which terms occur in complementary literals as clauses and units are
+// added or removed, so Consistent() takes constant time.
 //
 // The setup is implemented using watched literals: the empty clause and unit
 // clauses are stored separately from clauses with >= 2 literals, and for each
@@ -39,17 +46,28 @@
 // unit clause are watched. The watched-literals scheme has two advantages.
 // Firstly, it facilitates lazy unit propagation: a new literal is only tested
 // to be complementary to either of the watched literals, for only in this case
-// the clause can reduce to a unit clause after propagation. Only when the
-// clause reduces to a unit clause after propagation with all unit clauses, the
-// resulting unit clause is stored -- all non-unit results of unit propagation
-// are not stored and re-computed later on demand. The second advantage is that
-// since no clause added with AddClause() or AddUnit() is deleted during unit
-// propagation, backtracking can be implemented very cheaply: we just need to
-// adjust the pointers the last unit clause and the last clause to remove all
-// clauses that were added after the point we want to backtrack to. Note that
-// the watched literals may have been adjusted after this point; however, they
-// in particular satisfy their invariant of not being subsumed by any unit
-// clause at this earlier point, so we do not need to adjust them.
+// the clause can reduce to a unit clause after propagation. To find these
+// clauses quickly, every watched literal is registered in the watch list of its
+// left-hand side term; similarly, the unit clauses are indexed by their
+// left-hand side terms, which makes Determines() a constant-time lookup. Only
+// when the clause reduces to a unit clause after propagation with all unit
+// clauses, the resulting unit clause is stored -- all non-unit results of unit
+// propagation are not stored and re-computed later on demand. The second
+// advantage is that since no clause added with AddClause() or AddUnit() is
+// deleted during unit propagation, backtracking can be implemented very
+// cheaply: we just need to adjust the pointers the last unit clause and the
+// last clause to remove all clauses that were added after the point we want to
+// backtrack to. Note that the watched literals may have been adjusted after
+// this point; however, they in particular satisfy their invariant of not being
+// subsumed by any unit clause at this earlier point, so we do not need to
+// adjust them.
+//
+// Minimize() is the only operation that changes clauses and units instead of
+// appending new ones. When it rewrites the part of the setup some live
+// ShallowCopy refers to, the rewritten units, clauses, and clash changes are
+// recorded in a trail, from where the ShallowCopy restores them when it is
+// killed. Hence the cost of killing a ShallowCopy is proportional to what was
+// changed since it was created.
 //
 // The copy constructor and assignment operators are deleted, not for technical
 // reasons, but because it may likely lead to complications with the linked
@@ -61,6 +79,10 @@
 #include <cassert>
 
 #include <algorithm>
+#include <array>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -131,10 +153,7 @@ class Setup {
 
     void Kill() {
       if (setup_) {
-        assert(data_.empty_clause + data_.n_clauses + data_.n_units == 0 || setup_->saved_-- > 0);
-        setup_->empty_clause_ = data_.empty_clause;
-        setup_->units_.Resize(data_.n_units);
-        setup_->clauses_.Resize(data_.n_clauses);
+        setup_->Rollback(data_);
         setup_ = nullptr;
       }
     }
@@ -147,12 +166,7 @@ class Setup {
     Result AddClause(Clause c) { return setup_->AddClause(c); }
     Result AddUnit(Literal a) { return setup_->AddUnit(a); }
 
-    void Minimize() {
-      assert(data_.saved == setup_->saved_);
-      setup_->Minimize(data_.n_clauses, data_.n_units);
-      assert(data_.n_clauses <= setup_->clauses_.size());
-      assert(data_.n_units <= setup_->units_.size());
-    }
+    void Minimize(size_t n_threads = 1) { setup_->Minimize(data_, n_threads); }
 
     ClauseRange<GlobalIndex> new_clauses() const {
       const size_t last =
@@ -167,26 +181,125 @@ class Setup {
 
     struct Data {
       Data() = default;
-      Data(bool ec, size_t nc, size_t nu) : empty_clause(ec), n_clauses(nc), n_units(nu) {}
+      Data(bool ec, size_t nc, size_t nu, size_t ncc, size_t nt)
+          : empty_clause(ec), n_clauses(nc), n_units(nu), n_clash_changes(ncc), n_trail(nt) {}
+
+      // Returns true iff the setup restored by Rollback(*this) contains
+      // something beyond d.
+      bool Exceeds(const Data& d) const {
+        return n_clauses > d.n_clauses || n_units > d.n_units || n_clash_changes > d.n_clash_changes;
+      }
+
       bool empty_clause = false;
       size_t n_clauses = 0;
       size_t n_units = 0;
-#ifndef NDEBUG
-      size_t saved = 0;
-#endif
+      size_t n_clash_changes = 0;
+      size_t n_trail = 0;
     };
 
-    explicit ShallowCopy(Setup* s) : setup_(s), data_(Data(s->empty_clause_, s->clauses_.size(), s->units_.size())) {
-      assert(data_.empty_clause + data_.n_clauses + data_.n_units == 0 || ++setup_->saved_ > 0);
-#ifndef NDEBUG
-      data_.saved = s->saved_;
-#endif
+    explicit ShallowCopy(Setup* s)
+        : setup_(s),
+          data_(Data(s->empty_clause_, s->clauses_.size(), s->units_.size(), s->clashes_.n_changes(),
+                     s->trail_.size())) {
+      s->Protect(data_);
     }
 
     Setup* setup_ = nullptr;
     Data data_;
   };
 
+  // A ClauseView refers to a clause of the setup after unit propagation
+  // without copying it: iteration skips the literals complementary to some
+  // unit clause. It is invalidated by any change to the setup.
+  class ClauseView {
+   public:
+    class const_iterator {
+     public:
+      typedef std::ptrdiff_t difference_type;
+      typedef Literal value_type;
+      typedef const value_type* pointer;
+      typedef const value_type& reference;
+      typedef std::forward_iterator_tag iterator_category;
+
+      const_iterator() = default;
+      const_iterator(const Setup* s, const Literal* it, const Literal* end) : s_(s), it_(it), end_(end) { Skip(); }
+
+      bool operator==(const_iterator it) const { return it_ == it.it_; }
+      bool operator!=(const_iterator it) const { return !(*this == it); }
+
+      reference operator*() const { return *it_; }
+      pointer operator->() const { return it_; }
+
+      const_iterator& operator++() {
+        ++it_;
+        Skip();
+        return *this;
+      }
+      const_iterator operator++(int) {
+        const_iterator it = *this;
+        operator++();
+        return it;
+      }
+
+     private:
+      void Skip() {
+        for (; s_ && it_ != end_ && s_->units_.Complements(*it_); ++it_) {
+        }
+      }
+
+      const Setup* s_ = nullptr;
+      const Literal* it_ = nullptr;
+      const Literal* end_ = nullptr;
+    };
+
+    ClauseView() = default;
+
+    const_iterator begin() const { return const_iterator(s_, begin_, end_); }
+    const_iterator end()   const { return const_iterator(nullptr, end_, end_); }
+
+    Literal first() const { return *begin(); }
+
+    bool   empty() const { return begin() == end(); }
+    bool   unit()  const { return !empty() && std::next(begin()) == end(); }
+    size_t size()  const { return std::distance(begin(), end()); }
+
+    bool valid() const {
+      for (auto it = begin(); it != end(); ++it) {
+        for (auto jt = std::next(it); jt != end() && it->lhs() == jt->lhs(); ++jt) {
+          if (Literal::Valid(*it, *jt)) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    bool ground()    const { return all([](Literal a) { return a.ground(); }); }
+    bool primitive() const { return all([](Literal a) { return a.primitive(); }); }
+
+    template<typename UnaryPredicate>
+    bool any(UnaryPredicate p) const { return std::any_of(begin(), end(), p); }
+
+    template<typename UnaryPredicate>
+    bool all(UnaryPredicate p) const { return std::all_of(begin(), end(), p); }
+
+    explicit operator Clause() const { return Clause(begin(), end()); }
+
+    bool operator==(const ClauseView& c) const { return std::equal(begin(), end(), c.begin(), c.end()); }
+    bool operator!=(const ClauseView& c) const { return !(*this == c); }
+
+   private:
+    friend Setup;
+
+    // If s is null, [begin, end) is not filtered, which is the case for the
+    // empty clause and unit clauses.
+    ClauseView(const Setup* s, const Literal* begin, const Literal* end) : s_(s), begin_(begin), end_(end) {}
+
+    const Setup* s_ = nullptr;
+    const Literal* begin_ = nullptr;
+    const Literal* end_ = nullptr;
+  };
+
   Setup() = default;
   Setup(const Setup&) = delete;
   Setup& operator=(const Setup&) = delete;
@@ -195,16 +308,14 @@ class Setup {
 
   ShallowCopy shallow_copy() { return ShallowCopy(this); }
 
-  void Minimize() {
-    Minimize(0, 0);
-    units_.SealOriginalUnits();  // units_.set() have been eliminated from all clauses, so not needed in AddUnit()
-  }
+  // Minimize() tests the clauses for subsumption in n_threads threads; the
+  // result is the same for any number of threads.
+  void Minimize(size_t n_threads = 1) { Minimize(ShallowCopy::Data(), n_threads); }
 
   Result AddClause(Clause c) {
     assert(c.primitive());
     assert(!c.valid());
-    units_.UnsealOriginalUnits();  // undo units_.SealOriginalUnits() called by Minimize()
-    c.PropagateUnits(units_.set());
+    c.PropagateUnitsIf([this](Literal a) { return units_.Complements(a); });
     if (c.size() == 0) {
       empty_clause_ = true;
       return kInconsistent;
@@ -214,35 +325,65 @@ class Setup {
       return r;
     } else {
       clauses_.Add(c);
+      for (const Literal a : clauses_[clauses_.size() - 1]) {
+        clashes_.Add(a);
+      }
       return kOk;
     }
   }
 
+  // RestoreClause() adds the literals [begin, end) as a clause without unit
+  // propagation or other checks. They must be sorted and at least two, and
+  // none of them may be complementary to a unit; this holds for the clauses
+  // of a setup after unit propagation. It is meant for restoring setups.
+  template<typename ForwardIt>
+  void RestoreClause(ForwardIt begin, ForwardIt end) {
+    clauses_.Add(begin, end);
+    for (const Literal a : clauses_[clauses_.size() - 1]) {
+      assert(!units_.Complements(a));
+      clashes_.Add(a);
+    }
+  }
+
   Result AddUnit(Literal a) {
     assert(a.primitive());
     assert(!a.valid() && !a.invalid());
     if (empty_clause_) {
       return kInconsistent;
     }
-    size_t n_propagated = units_.size();
+    const size_t n_units = units_.size();
+    size_t n_propagated = n_units;
     const Result r = units_.Add(a);
     empty_clause_ = r == kInconsistent;
     for (; n_propagated < units_.size() && !empty_clause_; ++n_propagated) {
       a = units_[n_propagated];
-      for (size_t i = 0; i < clauses_.size() && !empty_clause_; ++i) {
-        if (Literal::Complementary(clauses_.watched(i).a, a) ||
-            Literal::Complementary(clauses_.watched(i).b, a)) {
-          Clause c = clauses_[i];
-          c.PropagateUnits(units_.set());
-          if (c.size() == 0) {
+      clauses_.ForEachWatcher(a.lhs(), [this, a](size_t i) {
+        if (!empty_clause_ &&
+            (Literal::Complementary(clauses_.watched(i).a, a) ||
+             Literal::Complementary(clauses_.watched(i).b, a))) {
+          const Literal* first = nullptr;
+          const Literal* last = nullptr;
+          for (const Literal& b : clauses_[i]) {
+            if (!units_.Complements(b)) {
+              first = !first ? &b : first;
+              last = &b;
+            }
+          }
+          if (!first) {
             empty_clause_ = true;
-          } else if (c.size() == 1) {
-            empty_clause_ = units_.Add(c.first()) == kInconsistent;
+          } else if (first == last) {
+            empty_clause_ = units_.Add(*first) == kInconsistent;
           } else {
-            clauses_.Watch(i, c.first(), c.last());
+            clauses_.Watch(i, *first, *last);
           }
         }
-      }
+      });
+    }
+    for (size_t j = n_units; j < units_.size(); ++j) {
+      TrackUnit(j, clauses_.size());
+    }
+    if (units_.size() > n_units) {
+      ++generation_;
     }
     return empty_clause_ ? kInconsistent : r;
   }
@@ -258,10 +399,8 @@ class Setup {
     if (!c.primitive()) {
       return c.valid();
     }
-    for (size_t i = 0; i < units_.size(); ++i) {
-      if (Clause::Subsumes(units_[i], c)) {
-        return true;
-      }
+    if (c.any([this](Literal a) { return units_.Subsumes(a); })) {
+      return true;
     }
     if (c.unit() && c.first().pos()) {
       return false;
@@ -269,35 +408,63 @@ class Setup {
     return ClausesSubsume(c);
   }
 
-  bool Consistent() const {
-    if (empty_clause_) {
-      return false;
+  // Calls f(i) for every i in clauses() such that c subsumes clause(i).
+  template<typename UnaryFunction>
+  void ForEachSubsumed(const Clause& c, UnaryFunction f) const {
+    assert(c.primitive());
+    if (c.empty()) {
+      for (size_t i : clauses()) {
+        f(i);
+      }
+      return;
     }
-    std::unordered_set<Literal, Literal::LhsHash> lits;
-    for (size_t i : clauses()) {
-      const Clause c = clause(i);
-      lits.insert(c.begin(), c.end());
+    const size_t offset = empty_clause_ ? 1 : 0;
+    if (c.first().lhs() == c.last().lhs()) {
+      units_.ForEach(c.first().lhs(), [this, &c, offset, &f](size_t i) {
+        if (Clause::Subsumes(c, Clause(units_[i]))) {
+          f(offset + i);
+        }
+      });
+    }
+    // Every clause subsumed by c mentions all lhs terms of c, so it suffices
+    // to test the clauses from the shortest of their occurrence lists.
+    const std::vector<size_t>* is = &clauses_.occurrences(c.first().lhs());
+    for (size_t j = 1; j < c.size() && !is->empty(); ++j) {
+      const std::vector<size_t>& js = clauses_.occurrences(c[j].lhs());
+      if (js.size() < is->size()) {
+        is = &js;
+      }
+    }
+    for (const size_t i : *is) {
+      if (SubsumesClause(c, i)) {
+        f(offset + units_.size() + i);
+      }
     }
-    return ConsistentSet(lits);
   }
 
+  bool Consistent() const { return !empty_clause_ && !clashes_.any(); }
+
   bool LocallyConsistent(const std::unordered_set<Term>& ts) const {
     assert(std::all_of(ts.begin(), ts.end(), [](Term t) { return t.primitive(); }));
-#ifdef BLOOM
-    internal::BloomSet<Term> bs;
-    for (Term t : ts) {
-      bs.Add(t);
+    if (std::any_of(ts.begin(), ts.end(), [this](Term t) { return clashes_.clashes(t); })) {
+      return false;
     }
-#endif
+    // The clauses that mention ts may also contain literals of other terms,
+    // which can only be complementary if they are so among all clauses.
     std::unordered_set<Literal, Literal::LhsHash> lits;
-    for (size_t i : clauses()) {
-      const Clause c = clause(i);
-      if (
-#ifdef BLOOM
-          bs.PossiblyOverlaps(c.lhs_bloom()) &&
-#endif
-          std::any_of(c.begin(), c.end(), [&ts](Literal a) { return ts.find(a.lhs()) != ts.end(); })) {
-        lits.insert(c.begin(), c.end());
+    for (const Term t : ts) {
+      for (const size_t i : clauses_.occurrences(t)) {
+        const Clauses::Literals c = clauses_[i];
+        const bool mentions = std::any_of(c.begin(), c.end(), [this, &ts](Literal a) {
+          return ts.find(a.lhs()) != ts.end() && !units_.Complements(a);
+        });
+        if (mentions) {
+          for (const Literal a : c) {
+            if (ts.find(a.lhs()) == ts.end() && clashes_.clashes(a.lhs()) && !units_.Complements(a)) {
+              lits.insert(a);
+            }
+          }
+        }
       }
     }
     return ConsistentSet(lits);
@@ -305,8 +472,7 @@ class Setup {
 
   bool contains_empty_clause() const { return empty_clause_; }
 
-  const std::unordered_set<Literal, Literal::LhsHash>& units() const { return units_.set(); }
-  const std::vector<Clause>& non_units() const { return clauses_.vec(); }
+  const std::vector<Literal>& units() const { return units_.vec(); }
 
   internal::Maybe<Term> Determines(Term lhs) const {
     assert(lhs.primitive());
@@ -315,20 +481,39 @@ class Setup {
 
   ClauseRange<> clauses() const { return ClauseRange<>(empty_clause_ + units_.size() + clauses_.size()); }
 
-  Clause clause(size_t i) const {
+  ClauseView clause(size_t i) const {
     if (i == 0 && empty_clause_) {
-      return Clause();
+      return ClauseView();
     }
     i -= empty_clause_ ? 1 : 0;
     if (i < units_.size()) {
-      return Clause(units_[i]);
+      const Literal* a = units_.vec().data() + i;
+      return ClauseView(nullptr, a, a + 1);
+    }
+    return PropagatedClause(i - units_.size());
+  }
+
+  // CachedClause() is like clause(), but it keeps the propagated clause in a
+  // cache, so it must not be called concurrently on the same setup.
+  ClauseView CachedClause(size_t i) {
+    if (i < (empty_clause_ ? 1 : 0) + units_.size()) {
+      return clause(i);
     }
-    i -= units_.size();
-    Clause c = clauses_[i];
-    c.PropagateUnits(units_.set());
-    return c;
+    bool hit;
+    const Clauses::Literals c = clauses_.Filter(i - (empty_clause_ ? 1 : 0) - units_.size(), generation_, &hit, [this](Literal a) {
+      return !units_.Complements(a);
+    });
+    ++(hit ? n_cache_hits_ : n_cache_misses_);
+    return ClauseView(nullptr, c.begin(), c.end());
   }
 
+  // The generation changes whenever units are added or clauses or units are
+  // removed. Until then, CachedClause() returns the cached propagated clause;
+  // the hits and misses of this cache are counted.
+  size_t generation() const { return generation_; }
+  size_t n_cache_hits() const { return n_cache_hits_; }
+  size_t n_cache_misses() const { return n_cache_misses_; }
+
  private:
   friend ShallowCopy;
 
@@ -340,167 +525,660 @@ class Setup {
     Literal b;
   };
 
+  // Clauses stores the literals of all non-unit clauses back to back in a
+  // single arena; a clause is a header with its offset and size in the arena
+  // and its watched literals. As clauses are only appended, the arena is
+  // ordered like the clauses, so truncating the clauses amounts to resetting
+  // the arena's end.
   class Clauses {
    public:
-    const Clause& operator[](size_t i) const { return clauses_[i]; }
-    Clause& operator[](size_t i) { return clauses_[i]; }
+    struct Literals {
+      Literals(const Literal* begin, const Literal* end) : begin_(begin), end_(end) {}
+
+      const Literal* begin() const { return begin_; }
+      const Literal* end()   const { return end_; }
+
+      const Literal& operator[](size_t i) const { return begin_[i]; }
 
-    Watched watched(size_t i) const { return watched_[i]; }
-    Watched& watched(size_t i) { return watched_[i]; }
+      size_t size() const { return end_ - begin_; }
 
-    void Add(const Clause& c) {
-      assert(c.size() >= 2);
-      watched_.push_back(Watched(c.first(), c.last()));
-      clauses_.push_back(c);
+     private:
+      const Literal* begin_;
+      const Literal* end_;
+    };
+
+    Literals operator[](size_t i) const {
+      const Literal* begin = lits_.data() + headers_[i].offset;
+      return Literals(begin, begin + headers_[i].size);
+    }
+
+    Watched watched(size_t i) const { return headers_[i].watched; }
+
+    void Add(const Clause& c) { Add(c.begin(), c.end()); }
+
+    template<typename ForwardIt>
+    void Add(ForwardIt begin, ForwardIt end) {
+      const size_t offset = lits_.size();
+      lits_.insert(lits_.end(), begin, end);
+      Append(offset, Watched(lits_[offset], lits_.back()));
     }
 
-    void Add(Clause&& c) {
-      assert(c.size() >= 2);
-      watched_.push_back(Watched(c.first(), c.last()));
-      clauses_.push_back(std::forward<Clause>(c));
+    // Adds a clause that watches w, as it did when it was removed.
+    template<typename ForwardIt>
+    void Add(ForwardIt begin, ForwardIt end, Watched w) {
+      const size_t offset = lits_.size();
+      lits_.insert(lits_.end(), begin, end);
+      Append(offset, w);
     }
 
     void Watch(size_t i, Literal a, Literal b) {
       assert(a < b);
-      watched_[i] = Watched(a, b);
+      Watched& w = headers_[i].watched;
+      const bool keep_a = w.a.lhs() == a.lhs();
+      const bool keep_b = w.a.lhs() != w.b.lhs() && a.lhs() != b.lhs() && w.b.lhs() == b.lhs();
+      if (!keep_b && w.a.lhs() != w.b.lhs()) {
+        Unlink(i, 1);
+      }
+      if (!keep_a) {
+        Unlink(i, 0);
+      }
+      w.a = a;
+      w.b = b;
+      if (!keep_a) {
+        Link(i, 0);
+      }
+      if (!keep_b && a.lhs() != b.lhs()) {
+        Link(i, 1);
+      }
+    }
+
+    size_t size() const { return headers_.size(); }
+
+    // Returns the literals of clause i for which p holds. They are stored in a
+    // copy of the arena and are recomputed only when the generation changes.
+    // The copy only grows when clauses were added, which invalidates earlier
+    // results anyway.
+    template<typename UnaryPredicate>
+    Literals Filter(size_t i, size_t generation, bool* hit, UnaryPredicate p) {
+      Header& h = headers_[i];
+      if (filtered_.size() < lits_.size()) {
+        filtered_.resize(lits_.size());
+      }
+      Literal* begin = filtered_.data() + h.offset;
+      *hit = h.filtered_generation == generation;
+      if (!*hit) {
+        const Literal* end = std::copy_if(lits_.data() + h.offset, lits_.data() + h.offset + h.size, begin, p);
+        h.filtered_generation = generation;
+        h.filtered_size = end - begin;
+      }
+      return Literals(begin, begin + h.filtered_size);
     }
 
-    size_t size() const {
-      assert(clauses_.size() == watched_.size());
-      return clauses_.size();
+    // Detach() removes clause i from the watch and occurrence lists, so that
+    // lookups ignore it until it is attached again with Attach().
+    void Detach(size_t i) {
+      if (watched_lhs(i, 0) != watched_lhs(i, 1)) {
+        Unlink(i, 1);
+      }
+      Unlink(i, 0);
+      Unindex(i);
     }
 
-    void Erase(size_t i) {
-      std::swap(clauses_[i], clauses_.back());
-      std::swap(watched_[i], watched_.back());
-      Resize(clauses_.size() - 1);
+    void Attach(size_t i) {
+      Link(i, 0);
+      if (watched_lhs(i, 0) != watched_lhs(i, 1)) {
+        Link(i, 1);
+      }
+      Index(i);
     }
 
     void Resize(size_t n) {
-      clauses_.resize(n);
-      watched_.resize(n);
+      for (size_t i = size(); i > n; --i) {
+        Detach(i - 1);
+      }
+      Truncate(n);
     }
 
-    const std::vector<Clause>& vec() const { return clauses_; }
+    // Drops all clauses from n on, which must have been detached.
+    void Truncate(size_t n) {
+      if (n < size()) {
+        lits_.resize(headers_[n].offset);
+        headers_.resize(n);
+      }
+    }
+
+    // Calls f(i) for every clause i that watches a literal with left-hand side
+    // t. f may re-watch clause i, which may move the last entry of the watch
+    // list to the current position, or append i to the list, in which case
+    // f(i) is called again.
+    template<typename UnaryFunction>
+    void ForEachWatcher(Term t, UnaryFunction f) const {
+      auto it = watch_lists_.find(t);
+      if (it == watch_lists_.end()) {
+        return;
+      }
+      const WatchList& ws = it->second;
+      for (size_t k = 0; k < ws.size(); ) {
+        const WatchRef w = ws[k];
+        f(w >> 1);
+        if (k < ws.size() && ws[k] == w) {
+          ++k;
+        }
+      }
+    }
+
+    // Returns true iff p(i) holds for some clause i whose first watched
+    // literal has left-hand side t and whose watched literals both subsume
+    // some of ds[0], ..., ds[n-1]. The latter is tested for batches of clauses
+    // by Literal::SubsumesAny().
+    template<typename UnaryPredicate>
+    bool AnyFirstWatcher(Term t, const Literal* ds, size_t n, UnaryPredicate p) const {
+      auto it = watch_lists_.find(t);
+      if (it == watch_lists_.end()) {
+        return false;
+      }
+      const WatchList& ws = it->second;
+      constexpr size_t kBatchSize = 16;
+      std::array<size_t, kBatchSize> is;
+      std::array<Literal, kBatchSize> as;
+      std::array<Literal, kBatchSize> bs;
+      bool as_subsume[kBatchSize];
+      bool bs_subsume[kBatchSize];
+      for (size_t k = 0; k < ws.size(); ) {
+        size_t m = 0;
+        for (; k < ws.size() && m < kBatchSize; ++k) {
+          if ((ws[k] & 1) == 0) {
+            is[m] = ws[k] >> 1;
+            as[m] = headers_[is[m]].watched.a;
+            bs[m] = headers_[is[m]].watched.b;
+            ++m;
+          }
+        }
+        Literal::SubsumesAny(as.data(), m, ds, n, as_subsume);
+        Literal::SubsumesAny(bs.data(), m, ds, n, bs_subsume);
+        for (size_t l = 0; l < m; ++l) {
+          if (as_subsume[l] && bs_subsume[l] && p(is[l])) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    // Returns the clauses that contain a literal with left-hand side t.
+    const std::vector<size_t>& occurrences(Term t) const {
+      static const std::vector<size_t> kNone;
+      auto it = occurrences_.find(t);
+      return it != occurrences_.end() ? it->second : kNone;
+    }
 
    private:
-    std::vector<Clause> clauses_;
-    std::vector<Watched> watched_;
+    // A WatchRef 2*i+s refers to the watched literal s (0 for a, 1 for b) of
+    // clause i. For every clause, each of its two watched literals has a
+    // WatchRef in the watch list of its lhs, except that b has none when both
+    // have the same lhs, so that no watch list contains a clause twice. The
+    // header keeps their positions in these lists so that they can be removed
+    // in constant time.
+    typedef size_t WatchRef;
+    typedef std::vector<WatchRef> WatchList;
+
+    struct Header {
+      size_t offset;
+      size_t size;
+      Watched watched;
+      std::array<size_t, 2> watch_pos;
+      size_t filtered_generation = 0;
+      size_t filtered_size = 0;
+    };
+
+    void Append(size_t offset, Watched w) {
+      Header h;
+      h.offset = offset;
+      h.size = lits_.size() - offset;
+      assert(h.size >= 2);
+      h.watched = w;
+      headers_.push_back(h);
+      Attach(headers_.size() - 1);
+    }
+
+    Term watched_lhs(size_t i, size_t s) const {
+      return s == 0 ? headers_[i].watched.a.lhs() : headers_[i].watched.b.lhs();
+    }
+
+    void Link(size_t i, size_t s) {
+      WatchList& ws = watch_lists_[watched_lhs(i, s)];
+      headers_[i].watch_pos[s] = ws.size();
+      ws.push_back(2 * i + s);
+    }
+
+    void Unlink(size_t i, size_t s) {
+      WatchList& ws = watch_lists_[watched_lhs(i, s)];
+      const size_t pos = headers_[i].watch_pos[s];
+      assert(pos < ws.size() && ws[pos] == 2 * i + s);
+      const WatchRef moved = ws.back();
+      ws[pos] = moved;
+      ws.pop_back();
+      if (moved != 2 * i + s) {
+        headers_[moved >> 1].watch_pos[moved & 1] = pos;
+      }
+    }
+
+    // Occurrence lists are ordered by clause index, so the most recently
+    // added clauses are found at their end.
+    template<typename UnaryFunction>
+    void ForEachLhs(size_t i, UnaryFunction f) const {
+      const Literals c = (*this)[i];
+      for (size_t j = 0; j < c.size(); ++j) {
+        if (j == 0 || c[j - 1].lhs() != c[j].lhs()) {
+          f(c[j].lhs());
+        }
+      }
+    }
+
+    void Index(size_t i) {
+      ForEachLhs(i, [this, i](Term t) {
+        std::vector<size_t>& is = occurrences_[t];
+        is.insert(std::upper_bound(is.begin(), is.end(), i), i);
+      });
+    }
+
+    void Unindex(size_t i) {
+      ForEachLhs(i, [this, i](Term t) {
+        std::vector<size_t>& is = occurrences_[t];
+        auto it = std::lower_bound(is.begin(), is.end(), i);
+        assert(it != is.end() && *it == i);
+        is.erase(it);
+      });
+    }
+
+    std::vector<Literal> lits_;
+    std::vector<Literal> filtered_;
+    std::vector<Header> headers_;
+    std::unordered_map<Term, WatchList> watch_lists_;
+    std::unordered_map<Term, std::vector<size_t>> occurrences_;
   };
 
+  // Units stores the unit clauses in the order they were added. As there is
+  // at most one positive unit per lhs, and the negative units with the same
+  // lhs are chained, a table indexed by Term::index() of the lhs finds all
+  // units of a term in constant time. Resize() restores the table when the
+  // units are truncated.
   class Units {
    public:
     Literal operator[](size_t i) const { return vec_[i]; }
 
-    size_t size() const {
-      assert(vec_.size() >= set_.size());
-      return vec_.size();
-    }
+    size_t size() const { return vec_.size(); }
 
     Result Add(Literal a) {
-      const auto orig_end = vec_.begin() + n_orig_;
-      const auto orig_begin = std::lower_bound(vec_.begin(), orig_end, Literal::Min(a.lhs()));
-      for (auto it = orig_begin; it != orig_end && a.lhs() == it->lhs(); ++it) {
-        if (Literal::Complementary(a, *it)) {
+      Slot& s = slot(a.lhs());
+      if (s.pos != 0) {
+        return Literal::Complementary(a, vec_[s.pos - 1]) ? kInconsistent : kSubsumed;
+      }
+      for (size_t i = s.neg; i != 0; i = prev_[i - 1]) {
+        const Literal b = vec_[i - 1];
+        if (Literal::Complementary(a, b)) {
           return kInconsistent;
         }
-        if (it->Subsumes(a)) {
+        if (b.Subsumes(a)) {
           return kSubsumed;
         }
       }
-      if (set_.bucket_count() > 0) {
-        const auto bucket = set_.bucket(a);
-        for (auto it = set_.begin(bucket), end = set_.end(bucket); it != end; ++it) {
-          if (Literal::Complementary(a, *it)) {
-            return kInconsistent;
-          }
-          if (it->Subsumes(a)) {
-            return kSubsumed;
-          }
-        }
-      }
-      assert(set_.find(a) == set_.end());
-      assert(std::find(vec_.begin(), vec_.end(), a) == vec_.end());
-      set_.insert(a);
       vec_.push_back(a);
+      if (a.pos()) {
+        prev_.push_back(0);
+        s.pos = vec_.size();
+      } else {
+        prev_.push_back(s.neg);
+        s.neg = vec_.size();
+      }
       return kOk;
     }
 
     void Resize(size_t n) {
-      assert(n == 0 || n >= n_orig_);
-      for (size_t i = n; i < vec_.size(); ++i) {
-        set_.erase(vec_[i]);
+      assert(n <= vec_.size());
+      for (size_t i = vec_.size(); i > n; --i) {
+        const Literal a = vec_[i - 1];
+        Slot& s = slots_[a.lhs().index()];
+        if (a.pos()) {
+          s.pos = 0;
+        } else {
+          s.neg = prev_[i - 1];
+        }
       }
       vec_.resize(n);
-      if (n == 0) {
-        n_orig_ = 0;
-      }
-    }
-
-    void Erase(size_t i) {
-      assert(n_orig_ == 0);
-      set_.erase(vec_[i]);
-      std::swap(vec_[i], vec_.back());
-      vec_.resize(vec_.size() - 1);
+      prev_.resize(n);
     }
 
-    void SealOriginalUnits() {
-      std::sort(vec_.begin(), vec_.end());
-      vec_.erase(std::unique(vec_.begin(), vec_.end()), vec_.end());
-      n_orig_ = vec_.size();
-      set_.clear();
+    // Returns true iff a is complementary to some unit i < n.
+    bool Complements(Literal a, size_t n = -1) const {
+      const Slot s = slot(a.lhs());
+      if (s.pos != 0 && s.pos <= n && Literal::Complementary(a, vec_[s.pos - 1])) {
+        return true;
+      }
+      if (a.pos()) {
+        for (size_t i = s.neg; i != 0; i = prev_[i - 1]) {
+          if (i <= n && vec_[i - 1].rhs() == a.rhs()) {
+            return true;
+          }
+        }
+      }
+      return false;
     }
 
-    void UnsealOriginalUnits() {
-      for (size_t i = 0; i < n_orig_; ++i) {
-        set_.insert(vec_[i]);
+    // Returns true iff a is subsumed by some unit.
+    bool Subsumes(Literal a) const {
+      const Slot s = slot(a.lhs());
+      if (s.pos != 0 && vec_[s.pos - 1].Subsumes(a)) {
+        return true;
+      }
+      if (!a.pos()) {
+        for (size_t i = s.neg; i != 0; i = prev_[i - 1]) {
+          if (vec_[i - 1] == a) {
+            return true;
+          }
+        }
       }
-      n_orig_ = 0;
+      return false;
     }
 
     internal::Maybe<Term> Determines(Term t) const {
       assert(t.primitive());
-      const auto orig_end = vec_.begin() + n_orig_;
-      const auto orig_begin = std::lower_bound(vec_.begin(), orig_end, Literal::Min(t));
-      for (auto it = orig_begin; it != orig_end && t == it->lhs(); ++it) {
-        if (it->pos()) {
-          return internal::Just(it->rhs());
-        }
+      const Slot s = slot(t);
+      return s.pos != 0 ? internal::Just(vec_[s.pos - 1].rhs()) : internal::Nothing;
+    }
+
+    // Calls f(i) for every unit i with lhs t.
+    template<typename UnaryFunction>
+    void ForEach(Term t, UnaryFunction f) const {
+      const Slot s = slot(t);
+      if (s.pos != 0) {
+        f(s.pos - 1);
       }
-      if (set_.bucket_count() > 0) {
-        auto bucket = set_.bucket(Literal::Min(t));
-        for (auto it = set_.begin(bucket), end = set_.end(bucket); it != end; ++it) {
-          if (it->lhs() == t && it->pos()) {
-            return internal::Just(it->rhs());
-          }
-        }
+      for (size_t i = s.neg; i != 0; i = prev_[i - 1]) {
+        f(i - 1);
       }
-      return internal::Nothing;
     }
 
-    const std::vector<Literal>&                          vec() const { return vec_; }
-    const std::unordered_set<Literal, Literal::LhsHash>& set() const { return set_; }
+    const std::vector<Literal>& vec() const { return vec_; }
 
    private:
+    // The indices of the positive and the last negative unit of a term, plus
+    // one, so that zero means there is none.
+    struct Slot {
+      size_t pos = 0;
+      size_t neg = 0;
+    };
+
+    Slot& slot(Term t) {
+      if (t.index() >= slots_.size()) {
+        slots_.resize(t.index() + 1);
+      }
+      return slots_[t.index()];
+    }
+
+    Slot slot(Term t) const { return t.index() < slots_.size() ? slots_[t.index()] : Slot(); }
+
     std::vector<Literal> vec_;
-    std::unordered_set<Literal, Literal::LhsHash> set_;
-    size_t n_orig_ = 0;
+    std::vector<size_t> prev_;
+    std::vector<Slot> slots_;
+  };
+
+  // Clashes counts the literals of all clauses after unit propagation by lhs
+  // and rhs, and thus keeps track of which terms occur in complementary
+  // literals. Every change is logged so that Undo() can revert it.
+  class Clashes {
+   public:
+    struct Change {
+      Change(Literal a, bool add) : a(a), add(add) {}
+      Literal a;
+      bool add;
+    };
+
+    void Add(Literal a)    { Update(a, true);  changes_.push_back(Change(a, true)); }
+    void Remove(Literal a) { Update(a, false); changes_.push_back(Change(a, false)); }
+
+    size_t n_changes() const { return changes_.size(); }
+
+    void Undo(size_t n) {
+      for (; changes_.size() > n; changes_.pop_back()) {
+        Update(changes_.back().a, !changes_.back().add);
+      }
+    }
+
+    // Returns the changes from n on, which Redo() applies again after Undo(n).
+    std::vector<Change> changes(size_t n) const { return std::vector<Change>(changes_.begin() + n, changes_.end()); }
+
+    void Redo(const std::vector<Change>& changes) {
+      for (const Change& c : changes) {
+        Update(c.a, c.add);
+        changes_.push_back(c);
+      }
+    }
+
+    bool any() const { return n_clashing_ > 0; }
+
+    bool clashes(Term t) const { return t.index() < terms_.size() && terms_[t.index()].clashes(); }
+
+   private:
+    struct Count {
+      explicit Count(Term rhs) : rhs(rhs) {}
+      Term rhs;
+      size_t pos = 0;
+      size_t neg = 0;
+    };
+
+    // A term clashes if it occurs in positive literals with two different
+    // names, or in a positive and a negative literal with the same name.
+    struct TermCounts {
+      bool clashes() const { return n_pos > 1 || n_pos_and_neg > 0; }
+      std::vector<Count> counts;
+      size_t n_pos = 0;
+      size_t n_pos_and_neg = 0;
+    };
+
+    void Update(Literal a, bool add) {
+      if (a.lhs().index() >= terms_.size()) {
+        terms_.resize(a.lhs().index() + 1);
+      }
+      TermCounts& tc = terms_[a.lhs().index()];
+      auto it = std::find_if(tc.counts.begin(), tc.counts.end(), [a](const Count& c) { return c.rhs == a.rhs(); });
+      if (it == tc.counts.end()) {
+        tc.counts.push_back(Count(a.rhs()));
+        it = tc.counts.end() - 1;
+      }
+      const bool clashed = tc.clashes();
+      tc.n_pos -= it->pos > 0;
+      tc.n_pos_and_neg -= it->pos > 0 && it->neg > 0;
+      size_t& n = a.pos() ? it->pos : it->neg;
+      if (add) {
+        ++n;
+      } else {
+        assert(n > 0);
+        --n;
+      }
+      tc.n_pos += it->pos > 0;
+      tc.n_pos_and_neg += it->pos > 0 && it->neg > 0;
+      n_clashing_ += tc.clashes();
+      n_clashing_ -= clashed;
+    }
+
+    std::vector<TermCounts> terms_;
+    std::vector<Change> changes_;
+    size_t n_clashing_ = 0;
+  };
+
+  // A Replacement keeps the units, clauses, and clash changes after base that
+  // Minimize() replaced, along with the watermark at that time.
+  struct Replacement {
+    Replacement(const ShallowCopy::Data& base, const ShallowCopy::Data& watermark)
+        : base(base), watermark(watermark) {}
+
+    ShallowCopy::Data base;
+    ShallowCopy::Data watermark;
+    std::vector<Literal> units;
+    std::vector<Literal> lits;
+    std::vector<size_t> ends;
+    std::vector<Watched> watched;
+    std::vector<Clashes::Change> changes;
   };
 
-  bool ClausesSubsume(const Clause& d) const {
-    assert(d.size() >= 1 && (d.size() >= 2 || !d.first().pos()));
-    for (size_t i = 0; i < clauses_.size(); ++i) {
-      if (Clause::Subsumes(clauses_.watched(i).a, clauses_.watched(i).b, d)) {
-        Clause c = clauses_[i];
-        c.PropagateUnits(units_.set());
-        if (Clause::Subsumes(c, d)) {
-          return true;
+  // The watermark bounds the savepoints of the ShallowCopies created since
+  // the last Replacement. Minimize() needs to record a Replacement only if it
+  // changes something below the watermark, as the earlier ShallowCopies are
+  // protected by that Replacement.
+  void Protect(const ShallowCopy::Data& d) {
+    watermark_.n_clauses = std::max(watermark_.n_clauses, d.n_clauses);
+    watermark_.n_units = std::max(watermark_.n_units, d.n_units);
+    watermark_.n_clash_changes = std::max(watermark_.n_clash_changes, d.n_clash_changes);
+  }
+
+  void Record(const ShallowCopy::Data& base) {
+    trail_.emplace_back(base, watermark_);
+    Replacement& r = trail_.back();
+    r.units.assign(units_.vec().begin() + base.n_units, units_.vec().end());
+    for (size_t i = base.n_clauses; i < clauses_.size(); ++i) {
+      const Clauses::Literals c = clauses_[i];
+      r.lits.insert(r.lits.end(), c.begin(), c.end());
+      r.ends.push_back(r.lits.size());
+      r.watched.push_back(clauses_.watched(i));
+    }
+    r.changes = clashes_.changes(base.n_clash_changes);
+    watermark_ = base;
+  }
+
+  void Restore(const Replacement& r) {
+    units_.Resize(r.base.n_units);
+    clauses_.Resize(r.base.n_clauses);
+    clashes_.Undo(r.base.n_clash_changes);
+    for (const Literal a : r.units) {
+      const Result res = units_.Add(a);
+      assert(res == kOk), (void) res;
+    }
+    for (size_t j = 0; j < r.ends.size(); ++j) {
+      clauses_.Add(r.lits.begin() + (j > 0 ? r.ends[j - 1] : 0), r.lits.begin() + r.ends[j], r.watched[j]);
+    }
+    clashes_.Redo(r.changes);
+  }
+
+  // Restores the setup as it was when d was saved. A Replacement with a base
+  // beyond d need not be restored, as the truncation removes all of it.
+  void Rollback(const ShallowCopy::Data& d) {
+    ++generation_;
+    for (; trail_.size() > d.n_trail; trail_.pop_back()) {
+      const Replacement& r = trail_.back();
+      if (d.Exceeds(r.base)) {
+        Restore(r);
+      }
+      watermark_ = r.watermark;
+    }
+    empty_clause_ = d.empty_clause;
+    units_.Resize(d.n_units);
+    clauses_.Resize(d.n_clauses);
+    clashes_.Undo(d.n_clash_changes);
+    watermark_.n_clauses = std::min(watermark_.n_clauses, d.n_clauses);
+    watermark_.n_units = std::min(watermark_.n_units, d.n_units);
+    watermark_.n_clash_changes = std::min(watermark_.n_clash_changes, d.n_clash_changes);
+  }
+
+  // Adds unit j to clashes_ and removes the literals complementary to it from
+  // the clauses before n, unless they were removed by an earlier unit.
+  void TrackUnit(size_t j, size_t n) {
+    const Literal a = units_[j];
+    clashes_.Add(a);
+    for (const size_t i : clauses_.occurrences(a.lhs())) {
+      if (i >= n) {
+        break;
+      }
+      for (const Literal b : clauses_[i]) {
+        if (Literal::Complementary(a, b) && !units_.Complements(b, j)) {
+          clashes_.Remove(b);
         }
       }
     }
+  }
+
+  template<typename ClauseType>
+  bool ClausesSubsume(const ClauseType& d) const {
+    return ClausesSubsume(d, [](size_t) { return true; });
+  }
+
+  // Returns true iff some clause i with p(i) subsumes d, which is a Clause or
+  // a ClauseView.
+  template<typename ClauseType, typename UnaryPredicate>
+  bool ClausesSubsume(const ClauseType& d, UnaryPredicate p) const {
+    // The literals of d are copied to an array for Literal::SubsumesAny(),
+    // which lives on the stack unless d is long.
+    constexpr size_t kMaxStackSize = 16;
+    std::array<Literal, kMaxStackSize> stack;
+    std::vector<Literal> heap;
+    size_t n = 0;
+    for (const Literal a : d) {
+      if (n < kMaxStackSize) {
+        stack[n] = a;
+      } else {
+        if (n == kMaxStackSize) {
+          heap.assign(stack.begin(), stack.end());
+        }
+        heap.push_back(a);
+      }
+      ++n;
+    }
+    const Literal* ds = n > kMaxStackSize ? heap.data() : stack.data();
+    assert(n >= 1 && (n >= 2 || !ds[0].pos()));
+    // The watched literals survive unit propagation, so a clause can only
+    // subsume d if its first watched literal's lhs occurs in d.
+    for (size_t j = 0; j < n; ++j) {
+      if (j > 0 && ds[j - 1].lhs() == ds[j].lhs()) {
+        continue;
+      }
+      const bool subsumed = clauses_.AnyFirstWatcher(ds[j].lhs(), ds, n, [this, ds, n, &p](size_t i) {
+        return ClauseSubsumes(i, ds, n) && p(i);
+      });
+      if (subsumed) {
+        return true;
+      }
+    }
     return false;
   }
 
+  // Returns true iff clause i subsumes ds[0], ..., ds[n-1] after unit
+  // propagation.
+  bool ClauseSubsumes(size_t i, const Literal* ds, size_t n) const {
+    size_t j = 0;
+    for (const Literal a : clauses_[i]) {
+      if (units_.Complements(a)) {
+        continue;
+      }
+      for (; j < n && a.lhs() > ds[j].lhs(); ++j) {
+      }
+      size_t k = j;
+      for (; k < n && a.lhs() == ds[k].lhs() && !a.Subsumes(ds[k]); ++k) {
+      }
+      if (k == n || a.lhs() != ds[k].lhs()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns true iff c subsumes clause i after unit propagation.
+  template<typename ClauseType>
+  bool SubsumesClause(const ClauseType& c, size_t i) const {
+    const Clauses::Literals d = clauses_[i];
+    size_t j = 0;
+    for (const Literal a : c) {
+      for (; j < d.size() && a.lhs() > d[j].lhs(); ++j) {
+      }
+      size_t k = j;
+      for (; k < d.size() && a.lhs() == d[k].lhs() && (!a.Subsumes(d[k]) || units_.Complements(d[k])); ++k) {
+      }
+      if (k == d.size() || a.lhs() != d[k].lhs()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   static bool ConsistentSet(const std::unordered_set<Literal, Literal::LhsHash>& lits) {
     for (const Literal a : lits) {
       assert(lits.bucket_count() > 0);
@@ -518,41 +1196,129 @@ class Setup {
     return true;
   }
 
-  void Minimize(size_t n_clauses, size_t n_units) {
-    assert(n_clauses + n_units > 0 || saved_ == 0);
+  // Returns clause i after unit propagation.
+  ClauseView PropagatedClause(size_t i) const {
+    const Clauses::Literals lits = clauses_[i];
+    return ClauseView(this, lits.begin(), lits.end());
+  }
+
+  // Returns true iff clause i is redundant: it reduces to a unit clause, or
+  // it is subsumed by a unit or another clause. Of clauses that subsume each
+  // other, the first one is kept.
+  bool Redundant(size_t i) const {
+    const ClauseView c = PropagatedClause(i);
+    return c.size() < 2 ||
+           c.any([this](Literal a) { return units_.Subsumes(a); }) ||
+           ClausesSubsume(c, [this, i, &c](size_t j) { return j != i && (j < i || !SubsumesClause(c, j)); });
+  }
+
+  // Minimizes the setup after base. If the setup was minimized after some
+  // point before base since base was saved, it is minimized after that point.
+  void Minimize(ShallowCopy::Data base, size_t n_threads) {
+    ++generation_;
+    for (size_t i = base.n_trail; i < trail_.size(); ++i) {
+      base.n_clauses = std::min(base.n_clauses, trail_[i].base.n_clauses);
+      base.n_units = std::min(base.n_units, trail_[i].base.n_units);
+      base.n_clash_changes = std::min(base.n_clash_changes, trail_[i].base.n_clash_changes);
+    }
+    if (watermark_.Exceeds(base)) {
+      Record(base);
+    }
+    const size_t n_clauses = base.n_clauses;
+    const size_t n_units = base.n_units;
+    clashes_.Undo(base.n_clash_changes);
     if (empty_clause_) {
       clauses_.Resize(n_clauses);
       units_.Resize(n_units);
       return;
     }
+    // Negative units subsumed by a positive unit are dropped, and the
+    // remaining ones are re-added in sorted order.
+    std::vector<Literal> units;
     for (size_t i = n_units; i < units_.size(); ++i) {
       const Literal a = units_[i];
-      if (!a.pos()) {
-        units_.Erase(i);
-        Result r = units_.Add(a);
-        assert(r != kInconsistent), (void) r;
+      if (a.pos() || !units_.Determines(a.lhs())) {
+        units.push_back(a);
       }
     }
-    for (size_t i = clauses_.size(); i > n_clauses; --i) {
-      Clause c;
-      std::swap(c, clauses_[i - 1]);
-      c.PropagateUnits(units_.set());
-      assert(!c.empty());
-      assert(c.size() >= 2 ||
-             any_of(units_.vec().begin(), units_.vec().end(), [&c](Literal a) { return a.Subsumes(c.first()); }));
-      clauses_.Erase(i - 1);
-      if (c.size() >= 2 && !Subsumes(c)) {
-        clauses_.Add(c);
+    std::sort(units.begin(), units.end());
+    units_.Resize(n_units);
+    for (const Literal a : units) {
+      const Result r = units_.Add(a);
+      assert(r == kOk), (void) r;
+    }
+    // Sequentially, every clause is detached while it is tested for
+    // subsumption by the others. In parallel, the clauses are tested without
+    // detaching them, so a clause must not be dropped for a clause that
+    // subsumes it and is subsumed by it unless the latter comes first; this
+    // yields the same result. The remaining clauses are then re-added in
+    // propagated form.
+    std::vector<char> keep(clauses_.size() - n_clauses);
+    if (n_threads > 1) {
+      // Literal accessors resolve terms through the current thread's factory.
+      Term::Factory* const tf = Term::Factory::Instance();
+      std::vector<std::thread> threads;
+      for (size_t k = 0; k < n_threads; ++k) {
+        threads.emplace_back([this, &keep, tf, n_clauses, n_threads, k]() {
+          Term::Factory::Context ctx(tf);
+          for (size_t i = n_clauses + k; i < clauses_.size(); i += n_threads) {
+            keep[i - n_clauses] = !Redundant(i);
+          }
+        });
+      }
+      for (std::thread& t : threads) {
+        t.join();
+      }
+    } else {
+      for (size_t i = clauses_.size(); i > n_clauses; --i) {
+        clauses_.Detach(i - 1);
+        const ClauseView c = PropagatedClause(i - 1);
+        assert(!c.empty());
+        assert(c.size() >= 2 ||
+               any_of(units_.vec().begin(), units_.vec().end(), [&c](Literal a) { return a.Subsumes(c.first()); }));
+        if (!c.unit() && !c.any([this](Literal a) { return units_.Subsumes(a); }) && !ClausesSubsume(c)) {
+          clauses_.Attach(i - 1);
+          keep[i - 1 - n_clauses] = true;
+        }
+      }
+    }
+    std::vector<Literal> lits;
+    std::vector<size_t> ends;
+    for (size_t i = n_clauses; i < clauses_.size(); ++i) {
+      // Sequentially, only the kept clauses are still attached.
+      if (keep[i - n_clauses] || n_threads > 1) {
+        clauses_.Detach(i);
       }
+      if (keep[i - n_clauses]) {
+        for (const Literal a : clauses_[i]) {
+          if (!units_.Complements(a)) {
+            lits.push_back(a);
+          }
+        }
+        ends.push_back(lits.size());
+      }
+    }
+    clauses_.Truncate(n_clauses);
+    for (size_t j = 0; j < ends.size(); ++j) {
+      clauses_.Add(lits.begin() + (j > 0 ? ends[j - 1] : 0), lits.begin() + ends[j]);
+    }
+    for (size_t j = n_units; j < units_.size(); ++j) {
+      TrackUnit(j, n_clauses);
+    }
+    for (const Literal a : lits) {
+      clashes_.Add(a);
     }
   }
 
   bool empty_clause_ = false;
   Units units_;
   Clauses clauses_;
-#ifndef NDEBUG
-  mutable size_t saved_ = 0;
-#endif
+  Clashes clashes_;
+  std::vector<Replacement> trail_;
+  ShallowCopy::Data watermark_;
+  size_t generation_ = 1;
+  size_t n_cache_hits_ = 0;
+  size_t n_cache_misses_ = 0;
 };
 
 }  // namespace limbo
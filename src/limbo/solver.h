@@ -59,6 +59,7 @@ class Solver {
   const Setup& setup() const { return grounder_.setup(); }
 
   bool Entails(Formula::belief_level k, const Formula& phi, bool assume_consistent = false) {
+    Term::Factory::Context ctx(tf_);
     assert(phi.objective());
     assert(phi.free_vars().all_empty());
     Grounder::Undo undo1;
@@ -73,6 +74,7 @@ class Solver {
   }
 
   internal::Maybe<Term> Determines(Formula::belief_level k, Term lhs, bool assume_consistent = false) {
+    Term::Factory::Context ctx(tf_);
     assert(lhs.primitive());
     Grounder::Undo undo1;
     if (assume_consistent) {
@@ -95,6 +97,7 @@ class Solver {
   }
 
   bool EntailsComplete(int k, const Formula& phi, bool assume_consistent = false) {
+    Term::Factory::Context ctx(tf_);
     assert(phi.objective());
     assert(phi.free_vars().all_empty());
     Formula::Ref psi = Formula::Factory::Not(phi.Clone());
@@ -102,6 +105,7 @@ class Solver {
   }
 
   bool Consistent(int k, const Formula& phi, bool assume_consistent = false) {
+    Term::Factory::Context ctx(tf_);
     assert(phi.objective());
     assert(phi.free_vars().all_empty());
     Grounder::Undo undo1;
@@ -13,7 +13,24 @@
 // The implementation aims to keep Terms as lightweight as possible to
 // facilitate extremely fast copying and comparison. For that reason, Terms
 // are interned and represented only with an index in the heap structure.
-// Creating a Term a second time yields the same index.
+// Creating a Term a second time yields the same index. The Factory looks a
+// Term up by its symbol and arguments before it allocates anything. The heap
+// is a structure of arrays indexed by the Term's index: the symbols, the
+// flags, and the offsets of the arguments in a pool where the arguments of
+// all Terms are stored one after another. When these arrays grow, their old
+// copies are kept, so that Args, the view of a Term's arguments, remains
+// valid. Whether a Term is ground, primitive, or quasi-primitive is determined
+// once on creation and stored in the flags, so these tests cost a single
+// lookup.
+//
+// Symbols and Terms may be created by several threads at once. Looking up
+// existing Terms and accessing their symbol and arguments does not lock.
+//
+// Besides the global factories, there may be any number of independent
+// Symbol::Factory and Term::Factory objects, for example one per knowledge
+// base. A Term is only meaningful with respect to the factory that created it;
+// a Term::Factory::Context makes a factory the one that Terms are resolved
+// with in the current thread. Destroying a factory frees all its Terms.
 //
 // Using an index as opposed to a memory address gives us more control over how
 // the representation of the Term looks like. In particular, it gets us the
@@ -32,26 +49,53 @@
 #include <cassert>
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <new>
 #include <utility>
 #include <vector>
 
 #include <limbo/internal/hash.h>
-#include <limbo/internal/intmap.h>
 #include <limbo/internal/ints.h>
 #include <limbo/internal/maybe.h>
 
 namespace limbo {
 
+// A Singleton has a global instance, which may be overridden per thread by
+// a Context: while a Context is alive, current() yields its object in the
+// thread that created it. Contexts can be nested. The global instance is
+// created on first use by global(), which is safe even if several threads
+// make the first call at once; Reset() must not race with other calls.
 template<typename T>
 struct Singleton {
-  static std::unique_ptr<T> instance;
-};
+  class Context {
+   public:
+    explicit Context(T* current) : previous_(current_ref()) { current_ref() = current; }
+    ~Context() { current_ref() = previous_; }
 
-template<typename T>
-std::unique_ptr<T> Singleton<T>::instance;
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+    Context(Context&&) = delete;
+    Context& operator=(Context&&) = delete;
+
+   private:
+    T* const previous_;
+  };
+
+  static T* current() { return current_ref(); }
+
+  static T*& current_ref() {
+    static thread_local T* current = nullptr;
+    return current;
+  }
+
+  static std::unique_ptr<T>& global() {
+    static std::unique_ptr<T> instance(new T());
+    return instance;
+  }
+};
 
 class Symbol {
  public:
@@ -61,14 +105,22 @@ class Symbol {
 
   class Factory : private Singleton<Factory> {
    public:
+    using Singleton<Factory>::Context;
+
+    Factory() = default;
+    Factory(const Factory&) = delete;
+    Factory& operator=(const Factory&) = delete;
+    Factory(Factory&&) = delete;
+    Factory& operator=(Factory&&) = delete;
+
     static Factory* Instance() {
-      if (instance == nullptr) {
-        instance = std::unique_ptr<Factory>(new Factory());
+      if (Factory* f = current()) {
+        return f;
       }
-      return instance.get();
+      return global().get();
     }
 
-    static void Reset() { instance = nullptr; }
+    static void Reset() { global().reset(new Factory()); }
 
     static Symbol CreateName(Id id, Sort sort) {
       assert(id > 0);
@@ -90,17 +142,26 @@ class Symbol {
     Symbol CreateVariable(Sort sort)              { return CreateVariable(++last_variable_, sort); }
     Symbol CreateFunction(Sort sort, Arity arity) { return CreateFunction(++last_function_, sort, arity); }
 
+    // Makes sure that sorts and symbols created later on differ from those of
+    // a symbol that was created with an explicit id, for example, by another
+    // factory.
+    void Reserve(Symbol s) {
+      AtLeast(&last_sort_, static_cast<Sort>(s.sort() + 1));
+      AtLeast(s.name() ? &last_name_ : s.variable() ? &last_variable_ : &last_function_, s.id());
+    }
+
    private:
-    Factory() = default;
-    Factory(const Factory&) = delete;
-    Factory& operator=(const Factory&) = delete;
-    Factory(Factory&&) = delete;
-    Factory& operator=(Factory&&) = delete;
+    template<typename T>
+    static void AtLeast(std::atomic<T>* last, T id) {
+      T prev = last->load(std::memory_order_relaxed);
+      while (prev < id && !last->compare_exchange_weak(prev, id, std::memory_order_relaxed)) {
+      }
+    }
 
-    Sort last_sort_ = 0;
-    Id last_function_ = 0;
-    Id last_name_ = 0;
-    Id last_variable_ = 0;
+    std::atomic<Sort> last_sort_{0};
+    std::atomic<Id> last_function_{0};
+    std::atomic<Id> last_name_{0};
+    std::atomic<Id> last_variable_{0};
   };
 
   bool operator==(Symbol s) const {
@@ -135,7 +196,9 @@ class Term {
  public:
   typedef internal::size_t size_t;
   class Factory;
+  class Args;
   struct Substitution;
+  class SubstitutionMemo;
   typedef std::vector<Term> Vector;  // using Vector within Term will be legal in C++17, but seems to be illegal before
   typedef internal::i8 UnificationConfiguration;
 
@@ -156,9 +219,13 @@ class Term {
 
   internal::hash32_t hash() const { return internal::jenkins_hash(id_); }
 
+  // index() is the position in the heap of names or non-names, respectively;
+  // it is dense and hence suited to index tables by terms.
+  internal::u32 index() const { return id_ >> 1; }
+
   inline Symbol symbol()      const;
   inline Term arg(size_t i)   const;
-  inline const Vector& args() const;
+  inline Args args()          const;
 
   Symbol::Sort sort()   const { return symbol().sort(); }
   bool name()           const { assert(symbol().name() == (id_ & 1)); return (id_ & 1) == 1; }
@@ -167,9 +234,9 @@ class Term {
   Symbol::Arity arity() const { return symbol().arity(); }
 
   bool null()           const { return id_ == 0; }
-  bool ground()         const { return name() || (function() && all_args([](Term t) { return t.ground(); })); }
-  bool primitive()      const { return function() && all_args([](Term t) { return t.name(); }); }
-  bool quasiprimitive() const { return function() && all_args([](Term t) { return t.name() || t.variable(); }); }
+  inline bool ground()         const;
+  inline bool primitive()      const;
+  inline bool quasiprimitive() const;
 
   bool Mentions(Term t) const { return *this == t || any_arg([t](Term tt) { return t == tt; }); }
 
@@ -191,106 +258,357 @@ class Term {
   friend class Literal;
 
   typedef internal::u32 u32;
+  typedef internal::u8 Flags;
 
-  struct Data;
+  static constexpr Flags kGround         = (1 << 0);
+  static constexpr Flags kPrimitive      = (1 << 1);
+  static constexpr Flags kQuasiprimitive = (1 << 2);
 
   explicit Term(u32 id) : id_(id) {}
 
-  inline const Data* data() const;
+  inline Flags flags() const;
 
   u32 id() const { return id_; }
 
-  template<typename UnaryPredicate>
-  inline bool all_args(UnaryPredicate p) const;
-
   template<typename UnaryPredicate>
   inline bool any_arg(UnaryPredicate p) const;
 
   u32 id_;
 };
 
-struct Term::Data {
-  Data(Symbol symbol, const Vector& args) : symbol(symbol), args(args) {}
+class Term::Args {
+ public:
+  typedef const Term* const_iterator;
+  typedef const_iterator iterator;
+  typedef Term value_type;
 
-  bool operator==(const Data& d) const { return symbol == d.symbol && args == d.args; }
-  bool operator!=(const Data& s) const { return !(*this == s); }
+  Args(const Term* begin, const Term* end) : begin_(begin), end_(end) {}
 
-  internal::hash32_t hash() const {
-    internal::hash32_t h = symbol.hash();
-    for (const limbo::Term t : args) {
-      h ^= t.hash();
-    }
-    return h;
-  }
+  bool operator==(const Args& a) const { return std::equal(begin_, end_, a.begin_, a.end_); }
+  bool operator!=(const Args& a) const { return !(*this == a); }
 
-  Symbol symbol;
-  Vector args;
+  const_iterator begin() const { return begin_; }
+  const_iterator end()   const { return end_; }
+
+  Term operator[](size_t i) const { return begin_[i]; }
+  size_t size()             const { return end_ - begin_; }
+  bool empty()              const { return begin_ == end_; }
+
+ private:
+  const Term* begin_;
+  const Term* end_;
 };
 
 class Term::Factory : private Singleton<Factory> {
  public:
-  static Factory* Instance() {
-    if (instance == nullptr) {
-      instance = std::unique_ptr<Factory>(new Factory());
-    }
-    return instance.get();
-  }
+  using Singleton<Factory>::Context;
 
-  static void Reset() { instance = nullptr; }
+  Factory() = default;
+  Factory(const Factory&) = delete;
+  Factory& operator=(const Factory&) = delete;
+  Factory(Factory&&) = delete;
+  Factory& operator=(Factory&&) = delete;
 
-  ~Factory() {
-    for (Data* data : name_heap_) {
-      delete data;
-    }
-    for (Data* data : variable_and_function_heap_) {
-      delete data;
+  // Term accessors like symbol() and args() resolve the Term through the
+  // factory returned by Instance(). That is the factory of the innermost
+  // Context of the current thread, or else the global factory.
+  static Factory* Instance() {
+    if (Factory* f = current()) {
+      return f;
     }
+    return global().get();
   }
 
+  static void Reset() { global().reset(new Factory()); }
+
   Term CreateTerm(Symbol symbol) {
-    return CreateTerm(symbol, {});
+    return CreateTerm(symbol, nullptr, nullptr);
   }
 
   Term CreateTerm(Symbol symbol, const Vector& args) {
-    assert(symbol.arity() == static_cast<Symbol::Arity>(args.size()));
-    Data* d = new Data(symbol, args);
-    DataPtrSet* s = &memory_[symbol.sort()];
-    auto it = s->find(d);
-    if (it == s->end()) {
-      std::vector<Data*>* heap = symbol.name() ? &name_heap_ : &variable_and_function_heap_;
-      heap->push_back(d);
-      const u32 id = (static_cast<u32>(heap->size()) << 1) | static_cast<u32>(symbol.name());
-      s->insert(std::make_pair(d, id));
-      return Term(id);
-    } else {
-      const u32 id = it->second;
-      delete d;
-      return Term(id);
+    return CreateTerm(symbol, args.data(), args.data() + args.size());
+  }
+
+  // Returns the Term with the given symbol and arguments [begin, end). Only
+  // if it does not exist yet, the arguments are copied to the argument pool.
+  //
+  // CreateTerm() may be called from several threads at once. The terms are
+  // distributed over kShards shards by their hash. Finding an existing term
+  // takes no lock; only creating a new one locks its shard.
+  Term CreateTerm(Symbol symbol, const Term* begin, const Term* end) {
+    assert(symbol.arity() == static_cast<Symbol::Arity>(end - begin));
+    const internal::hash32_t h = Hash(symbol, begin, end);
+    Shard& shard = shards_[h >> (32 - kShardBits)];
+    const Table* table = shard.table.load(std::memory_order_acquire);
+    if (table) {
+      const u64 found = Find(*table, h, symbol, begin, end);
+      if (found != 0) {
+        return Term(static_cast<u32>(found));
+      }
+    }
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    table = shard.table.load(std::memory_order_relaxed);
+    if (!table || 2 * (shard.n_terms + 1) > table->size) {
+      Rehash(&shard);
+      table = shard.table.load(std::memory_order_relaxed);
     }
+    size_t empty;
+    const u64 found = Find(*table, h, symbol, begin, end, &empty);
+    if (found != 0) {
+      return Term(static_cast<u32>(found));
+    }
+    const size_t index = symbol.name()
+        ? name_heap_.Add(symbol)
+        : variable_and_function_heap_.Add(symbol, ComputeFlags(symbol, begin, end), args_.Add(begin, end));
+    const u32 id = (static_cast<u32>(index + 1) << 1) | static_cast<u32>(symbol.name());
+    table->slots[empty].store((static_cast<u64>(h) << 32) | id, std::memory_order_release);
+    ++shard.n_terms;
+    return Term(id);
   }
 
-  const Data* get(u32 id) const {
+  Symbol symbol(u32 id) const { return heap(id).symbol(heap_index(id)); }
+
+  Flags flags(u32 id) const {
     if ((id & 1) == 1) {
-      return name_heap_[(id >> 1) - 1];
-    } else {
-      return variable_and_function_heap_[(id >> 1) - 1];
+      return kGround;
     }
+    return variable_and_function_heap_.flags(heap_index(id));
+  }
+
+  Args args(u32 id) const {
+    const Heap& h = heap(id);
+    const size_t i = heap_index(id);
+    const size_t n = h.symbol(i).arity();
+    if (n == 0) {
+      return Args(nullptr, nullptr);
+    }
+    const Term* begin = args_.get(h.args(i));
+    return Args(begin, begin + n);
   }
 
  private:
-  struct DataPtrHash { internal::hash32_t operator()(const Term::Data* d) const { return d->hash(); } };
-  struct DataPtrEquals { bool operator()(const Term::Data* a, const Term::Data* b) const { return *a == *b; } };
+  typedef internal::u64 u64;
+
+  // A FlatArray is a contiguous array that grows by doubling. When it grows,
+  // the elements are copied to the larger array, but the old arrays are kept
+  // until the FlatArray is destroyed, so that pointers into them remain valid
+  // and reading an element need not synchronize with adding others. The total
+  // size of the old arrays is at most that of the current one. Adding elements
+  // must be synchronized by the caller.
+  template<typename T>
+  class FlatArray {
+   public:
+    static constexpr size_t kInitialCapacity = 1024;
 
-  Factory() = default;
-  Factory(const Factory&) = delete;
-  Factory& operator=(const Factory&) = delete;
-  Factory(Factory&&) = delete;
-  Factory& operator=(Factory&&) = delete;
+    FlatArray() = default;
+
+    ~FlatArray() {
+      for (T* a : arrays_) {
+        ::operator delete(a);
+      }
+    }
+
+    FlatArray(const FlatArray&) = delete;
+    FlatArray& operator=(const FlatArray&) = delete;
+    FlatArray(FlatArray&&) = delete;
+    FlatArray& operator=(FlatArray&&) = delete;
+
+    // Appends [begin, end) and returns the index of its first element.
+    size_t Add(const T* begin, const T* end) {
+      const size_t i = size_.load(std::memory_order_relaxed);
+      const size_t n = end - begin;
+      T* data = data_.load(std::memory_order_relaxed);
+      if (i + n > capacity_) {
+        capacity_ = capacity_ > 0 ? 2 * capacity_ : kInitialCapacity;
+        if (capacity_ < i + n) {
+          capacity_ = i + n;
+        }
+        T* grown = static_cast<T*>(::operator new(capacity_ * sizeof(T)));
+        std::uninitialized_copy(data, data + i, grown);
+        arrays_.push_back(grown);
+        data = grown;
+      }
+      std::uninitialized_copy(begin, end, data + i);
+      data_.store(data, std::memory_order_release);
+      size_.store(i + n, std::memory_order_release);
+      return i;
+    }
+
+    size_t Add(const T& x) { return Add(&x, &x + 1); }
+
+    const T* get(size_t i) const {
+      return data_.load(std::memory_order_acquire) + i;
+    }
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+   private:
+    std::atomic<T*> data_{nullptr};
+    std::atomic<size_t> size_{0};
+    size_t capacity_ = 0;
+    std::vector<T*> arrays_;
+  };
+
+  // A Heap stores terms as a structure of arrays: their symbols, their flags,
+  // and the positions of their arguments in the ArgPool. For names, which have
+  // no arguments and are always ground, only the symbol is stored.
+  class Heap {
+   public:
+    size_t Add(Symbol symbol) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return symbols_.Add(symbol);
+    }
+
+    size_t Add(Symbol symbol, Flags flags, u32 args) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      flags_.Add(flags);
+      args_.Add(args);
+      return symbols_.Add(symbol);
+    }
+
+    Symbol symbol(size_t i) const { return *symbols_.get(i); }
+    Flags flags(size_t i)   const { return *flags_.get(i); }
+    u32 args(size_t i)      const { return *args_.get(i); }
+    size_t size()           const { return symbols_.size(); }
+
+   private:
+    std::mutex mutex_;
+    FlatArray<Symbol> symbols_;
+    FlatArray<Flags> flags_;
+    FlatArray<u32> args_;
+  };
+
+  // The ArgPool stores the arguments of all terms one after another.
+  class ArgPool {
+   public:
+    u32 Add(const Term* begin, const Term* end) {
+      if (begin == end) {
+        return 0;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      return static_cast<u32>(terms_.Add(begin, end));
+    }
+
+    const Term* get(u32 i) const { return terms_.get(i); }
+
+   private:
+    std::mutex mutex_;
+    FlatArray<Term> terms_;
+  };
+
+  // A slot holds the hash and the id of a term, or zero if it is empty.
+  struct Table {
+    explicit Table(size_t size) : size(size), slots(new std::atomic<u64>[size]) {
+      for (size_t i = 0; i < size; ++i) {
+        slots[i].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    size_t size;
+    std::unique_ptr<std::atomic<u64>[]> slots;
+  };
+
+  // Readers may still probe a table after it was replaced by a larger one,
+  // so the old tables are kept until the Factory is destroyed. Their total
+  // size is at most that of the current table.
+  struct Shard {
+    std::mutex mutex;
+    std::atomic<const Table*> table{nullptr};
+    std::vector<std::unique_ptr<Table>> tables;
+    size_t n_terms = 0;
+  };
+
+  static constexpr size_t kShardBits = 4;
+  static constexpr size_t kShards = 1 << kShardBits;
+  static constexpr size_t kInitialTableSize = 64;
+
+  // The hash depends on the order of the arguments, so that f(m,n) and f(n,m)
+  // do not collide, which is common in grid-shaped domains.
+  static internal::hash32_t Hash(Symbol symbol, const Term* begin, const Term* end) {
+    internal::hash32_t h = symbol.hash();
+    for (const Term* t = begin; t != end; ++t) {
+      h = internal::murmur3_combine(h, t->id_);
+    }
+    return internal::murmur3_finalize(h, end - begin);
+  }
+
+  Flags ComputeFlags(Symbol symbol, const Term* begin, const Term* end) const {
+    bool ground = !symbol.variable();
+    bool primitive = symbol.function();
+    bool quasiprimitive = symbol.function();
+    for (const Term* t = begin; t != end; ++t) {
+      const Symbol s = this->symbol(t->id_);
+      ground &= (flags(t->id_) & kGround) != 0;
+      primitive &= s.name();
+      quasiprimitive &= s.name() || s.variable();
+    }
+    return (ground ? kGround : 0) |
+           (primitive ? kPrimitive : 0) |
+           (quasiprimitive ? kQuasiprimitive : 0);
+  }
+
+  // Returns the value of the slot that holds the given term, or zero if there
+  // is none. In that case, empty is set to the empty slot where the term
+  // belongs. The returned value is the one that was compared, for another
+  // thread may fill an empty slot at any time, so the slot must not be read
+  // again without holding the shard's lock.
+  u64 Find(const Table& table, internal::hash32_t h, Symbol symbol, const Term* begin, const Term* end,
+           size_t* empty = nullptr) const {
+    const size_t mask = table.size - 1;
+    size_t i = h & mask;
+    for (;; i = (i + 1) & mask) {
+      const u64 slot = table.slots[i].load(std::memory_order_acquire);
+      if (slot == 0) {
+        if (empty) {
+          *empty = i;
+        }
+        return 0;
+      }
+      if (static_cast<internal::hash32_t>(slot >> 32) == h) {
+        const u32 id = static_cast<u32>(slot);
+        const Heap& h = heap(id);
+        const size_t j = heap_index(id);
+        const Symbol s = h.symbol(j);
+        if (s.sort() == symbol.sort() && s == symbol &&
+            (begin == end || std::equal(begin, end, args_.get(h.args(j))))) {
+          return slot;
+        }
+      }
+    }
+  }
+
+  static void Rehash(Shard* shard) {
+    const Table* old = shard->table.load(std::memory_order_relaxed);
+    std::unique_ptr<Table> table(new Table(old ? 2 * old->size : kInitialTableSize));
+    const size_t mask = table->size - 1;
+    for (size_t j = 0; old && j < old->size; ++j) {
+      const u64 slot = old->slots[j].load(std::memory_order_relaxed);
+      if (slot != 0) {
+        size_t i = (slot >> 32) & mask;
+        while (table->slots[i].load(std::memory_order_relaxed) != 0) {
+          i = (i + 1) & mask;
+        }
+        table->slots[i].store(slot, std::memory_order_relaxed);
+      }
+    }
+    shard->table.store(table.get(), std::memory_order_release);
+    shard->tables.push_back(std::move(table));
+  }
+
+  const Heap& heap(u32 id) const { return (id & 1) == 1 ? name_heap_ : variable_and_function_heap_; }
+
+  // A Term resolved with a factory other than its own, for example because a
+  // Context is missing, most likely has an index out of range.
+  size_t heap_index(u32 id) const {
+    const size_t i = (id >> 1) - 1;
+    assert(i < heap(id).size() && "Term does not belong to the current Term::Factory");
+    return i;
+  }
 
-  typedef std::unordered_map<Data*, u32, DataPtrHash, DataPtrEquals> DataPtrSet;
-  internal::IntMap<Symbol::Sort, DataPtrSet> memory_;
-  std::vector<Data*> name_heap_;
-  std::vector<Data*> variable_and_function_heap_;
+  Shard shards_[kShards];
+  Heap name_heap_;
+  Heap variable_and_function_heap_;
+  ArgPool args_;
 };
 
 struct Term::Substitution {
@@ -319,16 +637,17 @@ struct Term::Substitution {
   std::vector<std::pair<Term, Term>> subs_;
 };
 
-inline Symbol Term::symbol()            const { return data()->symbol; }
-inline Term Term::arg(size_t i)         const { return data()->args[i]; }
-inline const Term::Vector& Term::args() const { return data()->args; }
-inline const Term::Data* Term::data()   const { return Factory::Instance()->get(id_); }
+inline Symbol Term::symbol()            const { return Factory::Instance()->symbol(id_); }
+inline Term Term::arg(size_t i)         const { return Factory::Instance()->args(id_)[i]; }
+inline Term::Args Term::args()          const { return Factory::Instance()->args(id_); }
+inline Term::Flags Term::flags()        const { return Factory::Instance()->flags(id_); }
 
-template<typename UnaryPredicate>
-inline bool Term::all_args(UnaryPredicate p) const { return std::all_of(data()->args.begin(), data()->args.end(), p); }
+inline bool Term::ground()         const { return (flags() & kGround) != 0; }
+inline bool Term::primitive()      const { return (flags() & kPrimitive) != 0; }
+inline bool Term::quasiprimitive() const { return (flags() & kQuasiprimitive) != 0; }
 
 template<typename UnaryPredicate>
-inline bool Term::any_arg(UnaryPredicate p) const { return std::any_of(data()->args.begin(), data()->args.end(), p); }
+inline bool Term::any_arg(UnaryPredicate p) const { const Args a = args(); return std::any_of(a.begin(), a.end(), p); }
 
 template<typename UnaryFunction>
 Term Term::Substitute(UnaryFunction theta, Factory* tf) const {
@@ -336,13 +655,20 @@ Term Term::Substitute(UnaryFunction theta, Factory* tf) const {
   if (t) {
     return t.val;
   } else if (arity() > 0) {
-    Vector args;
-    args.reserve(data()->args.size());
-    for (Term arg : data()->args) {
-      args.push_back(arg.Substitute(theta, tf));
+    // Most terms have few arguments, which we collect on the stack, so that
+    // no allocation happens if the substituted term exists already.
+    constexpr size_t kInlineArgs = 8;
+    const Args old_args = args();
+    Term inline_args[kInlineArgs];
+    Vector heap_args(old_args.size() > kInlineArgs ? old_args.size() : 0);
+    Term* new_args = old_args.size() > kInlineArgs ? heap_args.data() : inline_args;
+    bool changed = false;
+    for (size_t i = 0; i < old_args.size(); ++i) {
+      new_args[i] = old_args[i].Substitute(theta, tf);
+      changed |= new_args[i] != old_args[i];
     }
-    if (args != data()->args) {
-      return tf->CreateTerm(data()->symbol, args);
+    if (changed) {
+      return tf->CreateTerm(symbol(), new_args, new_args + old_args.size());
     } else {
       return *this;
     }
@@ -415,6 +741,144 @@ void Term::Traverse(UnaryFunction f) const {
   }
 }
 
+// A SubstitutionMemo remembers the results of Substitute() for substitutions
+// that replace variables only, as they occur in grounding. A result is stored
+// under the term and the values of the variables that occur in it, so that
+// grounding the term again with the same values for its variables is a lookup,
+// no matter how the other variables are assigned. Both the results and the
+// variables of terms are kept in tables with a fixed number of slots, where a
+// new entry replaces the old one in its slot. Terms with more than kMaxVars
+// variables are not memoized. The memo only pays off when the groundings that
+// recur fit into its slots; otherwise every lookup is a miss on top of the
+// substitution.
+//
+// Memoize() wraps a substitution so that it can be passed to the Substitute()
+// methods of Terms, Literals, and Clauses. Lookup() is for callers that know
+// the variables of a term and their values already. Since the results are
+// Terms, the memo must only be used with a single Term::Factory, and it must
+// only be used by one thread at a time.
+class Term::SubstitutionMemo {
+ public:
+  static constexpr size_t kMaxVars = 4;
+
+  template<typename UnaryFunction>
+  class Memoized {
+   public:
+    Memoized(SubstitutionMemo* memo, UnaryFunction theta, Factory* tf) : memo_(memo), theta_(theta), tf_(tf) {}
+
+    internal::Maybe<Term> operator()(Term t) const {
+      if (t.ground()) {
+        return internal::Just(t);
+      } else if (t.variable()) {
+        return theta_(t);
+      } else {
+        return internal::Just(memo_->Substitute(t, theta_, tf_));
+      }
+    }
+
+   private:
+    SubstitutionMemo* memo_;
+    UnaryFunction theta_;
+    Factory* tf_;
+  };
+
+  explicit SubstitutionMemo(size_t n_slots = 1 << 14) : results_(Capacity(n_slots)), vars_(Capacity(n_slots / 4)) {}
+
+  template<typename UnaryFunction>
+  Memoized<UnaryFunction> Memoize(UnaryFunction theta, Factory* tf) {
+    return Memoized<UnaryFunction>(this, theta, tf);
+  }
+
+  template<typename UnaryFunction>
+  Term Substitute(Term t, UnaryFunction theta, Factory* tf) {
+    const VarsSlot& vs = vars(t);
+    if (vs.size > kMaxVars) {
+      ++n_misses_;
+      return t.Substitute(theta, tf);
+    }
+    Term values[kMaxVars];
+    for (size_t i = 0; i < vs.size; ++i) {
+      const internal::Maybe<Term> v = theta(vs.vars[i]);
+      values[i] = v ? v.val : vs.vars[i];
+    }
+    return Lookup(t, values, vs.size, [t, theta, tf]() { return t.Substitute(theta, tf); });
+  }
+
+  // Returns the result stored for t and the n <= kMaxVars values of its
+  // variables, or else stores and returns create().
+  template<typename NullaryFunction>
+  Term Lookup(Term t, const Term* values, size_t n, NullaryFunction create) {
+    assert(n <= kMaxVars);
+    internal::hash32_t h = t.hash();
+    for (size_t i = 0; i < n; ++i) {
+      h = internal::murmur3_combine(h, values[i].id_);
+    }
+    h = internal::murmur3_finalize(h, n);
+    ResultSlot& r = results_[h & (results_.size() - 1)];
+    if (r.term == t && std::equal(values, values + n, r.values)) {
+      ++n_hits_;
+      return r.result;
+    }
+    ++n_misses_;
+    r.term = t;
+    std::copy(values, values + n, r.values);
+    r.result = create();
+    return r.result;
+  }
+
+  void Clear() {
+    std::fill(results_.begin(), results_.end(), ResultSlot());
+    std::fill(vars_.begin(), vars_.end(), VarsSlot());
+  }
+
+  size_t n_hits()   const { return n_hits_; }
+  size_t n_misses() const { return n_misses_; }
+
+ private:
+  struct ResultSlot {
+    Term term = Term(0);
+    Term values[kMaxVars] = {};
+    Term result = Term(0);
+  };
+
+  struct VarsSlot {
+    Term term = Term(0);
+    size_t size = 0;
+    Term vars[kMaxVars] = {};
+  };
+
+  static size_t Capacity(size_t n) {
+    size_t c = 1;
+    while (c < n) {
+      c *= 2;
+    }
+    return c;
+  }
+
+  const VarsSlot& vars(Term t) {
+    VarsSlot& vs = vars_[t.hash() & (vars_.size() - 1)];
+    if (vs.term != t) {
+      vs.term = t;
+      vs.size = 0;
+      t.Traverse([&vs](Term x) {
+        if (x.variable() && vs.size <= kMaxVars && std::find(vs.vars, vs.vars + vs.size, x) == vs.vars + vs.size) {
+          if (vs.size < kMaxVars) {
+            vs.vars[vs.size] = x;
+          }
+          ++vs.size;
+        }
+        return !x.ground();
+      });
+    }
+    return vs;
+  }
+
+  std::vector<ResultSlot> results_;
+  std::vector<VarsSlot> vars_;
+  size_t n_hits_ = 0;
+  size_t n_misses_ = 0;
+};
+
 }  // namespace limbo
 
 
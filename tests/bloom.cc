@@ -12,7 +12,8 @@ namespace internal {
 
 using namespace limbo::format;
 
-TEST(BloomFilterTest, Subset_Contains) {
+template<size_t Bits>
+void TestSubsetContains() {
   Symbol::Factory& sf = *Symbol::Factory::Instance();
   Term::Factory& tf = *Term::Factory::Instance();
   const Symbol::Sort s1 = sf.CreateSort();
@@ -30,8 +31,8 @@ TEST(BloomFilterTest, Subset_Contains) {
   const Term f4 = tf.CreateTerm(h, {n1,f1});
   const std::vector<Term> ts({n1,n2,x1,x2,f1,f2,f3});
 
-  BloomFilter bf0;
-  BloomFilter bf1;
+  BloomFilter<Bits> bf0;
+  BloomFilter<Bits> bf1;
 
   for (Term t : ts) {
     EXPECT_TRUE(bf0.SubsetOf(bf1));
@@ -70,30 +71,75 @@ TEST(BloomFilterTest, Subset_Contains) {
   EXPECT_FALSE(bf1.SubsetOf(bf0));
 }
 
+TEST(BloomFilterTest, Subset_Contains) {
+  TestSubsetContains<64>();
+  TestSubsetContains<128>();
+  TestSubsetContains<256>();
+}
+
 #if 0
 TEST(BloomFilterTest, hash) {
   const uint64_t x = 0xFF03FF02FF01FF00;
-  EXPECT_EQ(BloomFilter::hash<0>(x), 0xFF00);
-  EXPECT_EQ(BloomFilter::hash<1>(x), 0xFF01);
-  EXPECT_EQ(BloomFilter::hash<2>(x), 0xFF02);
-  EXPECT_EQ(BloomFilter::hash<3>(x), 0xFF03);
+  EXPECT_EQ(BloomFilter<64>::hash<0>(x), 0xFF00);
+  EXPECT_EQ(BloomFilter<64>::hash<1>(x), 0xFF01);
+  EXPECT_EQ(BloomFilter<64>::hash<2>(x), 0xFF02);
+  EXPECT_EQ(BloomFilter<64>::hash<3>(x), 0xFF03);
 }
 #endif
 
 TEST(BloomFilterTest, hash) {
   const uint64_t x = 0xFF03FF02FF01FF00;
-  EXPECT_EQ(BloomFilter::index<0>(x), 0x00);
-  EXPECT_EQ(BloomFilter::index<1>(x), 0x3F);
-  EXPECT_EQ(BloomFilter::index<2>(x), 0x01);
-  EXPECT_EQ(BloomFilter::index<3>(x), 0x3F);
-  EXPECT_EQ(BloomFilter::index<4>(x), 0x02);
-  EXPECT_EQ(BloomFilter::index<5>(x), 0x3F);
-  EXPECT_EQ(BloomFilter::index<6>(x), 0x03);
-  EXPECT_EQ(BloomFilter::index<7>(x), 0x3F);
-  EXPECT_EQ(BloomFilter::index<0>(static_cast<uint64_t>(64)), 0);
-  EXPECT_EQ(BloomFilter::index<0>(static_cast<uint64_t>(63)), 63);
-  EXPECT_EQ(BloomFilter::index<7>(static_cast<uint64_t>(64) << (7*8)), 0);
-  EXPECT_EQ(BloomFilter::index<7>(static_cast<uint64_t>(63) << (7*8)), 63);
+  EXPECT_EQ(BloomFilter<64>::index<0>(x), 0x00);
+  EXPECT_EQ(BloomFilter<64>::index<1>(x), 0x3F);
+  EXPECT_EQ(BloomFilter<64>::index<2>(x), 0x01);
+  EXPECT_EQ(BloomFilter<64>::index<3>(x), 0x3F);
+  EXPECT_EQ(BloomFilter<64>::index<4>(x), 0x02);
+  EXPECT_EQ(BloomFilter<64>::index<5>(x), 0x3F);
+  EXPECT_EQ(BloomFilter<64>::index<6>(x), 0x03);
+  EXPECT_EQ(BloomFilter<64>::index<7>(x), 0x3F);
+  EXPECT_EQ(BloomFilter<64>::index<0>(static_cast<uint64_t>(64)), 0);
+  EXPECT_EQ(BloomFilter<64>::index<0>(static_cast<uint64_t>(63)), 63);
+  EXPECT_EQ(BloomFilter<64>::index<7>(static_cast<uint64_t>(64) << (7*8)), 0);
+  EXPECT_EQ(BloomFilter<64>::index<7>(static_cast<uint64_t>(63) << (7*8)), 63);
+}
+
+TEST(BloomFilterTest, wide_hash) {
+  const uint64_t x = 0xFF03FF02FF01FF00;
+  EXPECT_EQ(BloomFilter<128>::index<0>(x), 0x00);
+  EXPECT_EQ(BloomFilter<128>::index<1>(x), 0x7F);
+  EXPECT_EQ(BloomFilter<128>::index<2>(x), 0x01);
+  EXPECT_EQ(BloomFilter<128>::index<7>(x), 0x7F);
+  EXPECT_EQ(BloomFilter<256>::index<0>(x), 0x00);
+  EXPECT_EQ(BloomFilter<256>::index<1>(x), 0xFF);
+  EXPECT_EQ(BloomFilter<256>::index<6>(x), 0x03);
+  EXPECT_EQ(BloomFilter<256>::index<7>(x), 0xFF);
+
+  // Indices in the upper words must not be confused with the lower ones.
+  BloomFilter<256> bf0;
+  BloomFilter<256> bf1;
+  bf0.Add(static_cast<uint32_t>(0xC0C0C0C0));
+  bf1.Add(static_cast<uint32_t>(0x00000000));
+  EXPECT_TRUE(bf0.Contains(static_cast<uint32_t>(0xC0C0C0C0)));
+  EXPECT_FALSE(bf0.Contains(static_cast<uint32_t>(0x40404040)));
+  EXPECT_FALSE(bf0.Overlaps(bf1));
+  EXPECT_FALSE(bf0.SubsetOf(bf1));
+  EXPECT_TRUE(BloomFilter<256>::Union(bf0, bf1).Contains(static_cast<uint32_t>(0x00000000)));
+  EXPECT_TRUE(BloomFilter<256>::Intersection(bf0, bf1) == BloomFilter<256>());
+}
+
+TEST(BloomFilterTest, stats) {
+  BloomStats* stats = BloomStats::Instance();
+  stats->Reset();
+  BloomStats::Record(BloomStats::kContains, []() { return true; });
+  BloomStats::Record(BloomStats::kContains, []() { return false; });
+  BloomStats::Record(BloomStats::kSubsetOf, []() { return false; });
+  const u64 n = BloomStats::kEnabled ? 1 : 0;
+  EXPECT_EQ(stats->positives(BloomStats::kContains), 2 * n);
+  EXPECT_EQ(stats->false_positives(BloomStats::kContains), n);
+  EXPECT_EQ(stats->positives(BloomStats::kSubsetOf), n);
+  EXPECT_EQ(stats->false_positives(BloomStats::kSubsetOf), n);
+  stats->Reset();
+  EXPECT_EQ(stats->positives(BloomStats::kContains), 0u);
 }
 
 }  // namespace internal
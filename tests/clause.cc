@@ -356,5 +356,33 @@ TEST(ClauseTest, Subsumes3) {
   EXPECT_TRUE(Clause{Literal::Neq(P,T)}.Subsumes(Clause{Literal::Neq(P,T)}));
 }
 
+TEST(ClauseTest, copy_assign) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  std::vector<Literal> lits;
+  for (size_t i = 0; i < 40; ++i) {
+    lits.push_back(Literal::Eq(tf.CreateTerm(sf.CreateFunction(s1, 0), {}), n));
+  }
+  auto clause = [&lits](size_t k) { return Clause(lits.begin(), lits.begin() + k); };
+
+  for (size_t k = 0; k < lits.size(); k += 3) {
+    for (size_t l = 0; l < lits.size(); l += 7) {
+      Clause c = clause(k);
+      const Clause d = clause(l);
+      c = d;
+      EXPECT_EQ(c, d);
+      EXPECT_EQ(c.size(), l);
+      EXPECT_TRUE(std::equal(d.cbegin(), d.cend(), c.cbegin(), c.cend()));
+      Clause e = std::move(c);
+      EXPECT_EQ(e, d);
+      EXPECT_TRUE(c.empty());
+      c = e;
+      EXPECT_EQ(c, d);
+    }
+  }
+}
+
 }  // namespace limbo
  
@@ -3,7 +3,10 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdlib>
+
 #include <unordered_set>
+#include <vector>
 
 #include <limbo/formula.h>
 #include <limbo/grounder.h>
@@ -18,7 +21,7 @@ using namespace limbo::format;
 std::unordered_set<Clause> unique(const Setup& s) {
   std::unordered_set<Clause> set;
   for (size_t i : s.clauses()) {
-    set.insert(s.clause(i));
+    set.insert(Clause(s.clause(i)));
   }
   return set;
 }
@@ -41,7 +44,7 @@ typedef std::unordered_set<Literal> LiteralSet;
 ClauseSet S(const Setup& s) {
   ClauseSet set;
   for (auto i : s.clauses()) {
-    set.insert(s.clause(i));
+    set.insert(Clause(s.clause(i)));
   }
   return set;
 }
@@ -129,6 +132,189 @@ TEST(GrounderTest, Ground_SplitTerms_Names) {
   }
 }
 
+TEST(GrounderTest, Memo) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort Bool = sf.CreateSort();
+  const Symbol::Sort s = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(Bool));
+  const Term m = tf.CreateTerm(sf.CreateName(s));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s));
+  const Term y = tf.CreateTerm(sf.CreateVariable(s));
+  const Symbol P = sf.CreateFunction(Bool, 2);
+  const Symbol Q = sf.CreateFunction(Bool, 1);
+  const Clause c{Literal::Eq(tf.CreateTerm(P, {x, y}), T), Literal::Eq(tf.CreateTerm(Q, {x}), T)};
+  Grounder plain(&sf, &tf);
+  Grounder memoized(&sf, &tf);
+  EXPECT_EQ(memoized.memo_slots(), 0u);
+  memoized.set_memo_slots(1 << 10);
+  EXPECT_EQ(memoized.memo_slots(), 1u << 10);
+  for (Grounder* g : {&plain, &memoized}) {
+    g->AddClause(c);
+    // The new name m leads to regrounding c, which creates many of the terms
+    // it created before.
+    g->AddClause(Clause{Literal::Eq(tf.CreateTerm(Q, {m}), T)});
+  }
+  // The grounders use different plus-names, so only the sizes are comparable.
+  EXPECT_EQ(unique_length(plain.setup()), unique_length(memoized.setup()));
+  EXPECT_GT(unique_length(memoized.setup()), 4u * 4u);
+  EXPECT_EQ(plain.n_memo_hits() + plain.n_memo_misses(), 0u);
+  EXPECT_GT(memoized.n_memo_hits(), 0u);
+  EXPECT_GT(memoized.n_memo_misses(), 0u);
+}
+
+TEST(GrounderTest, Plan) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s = sf.CreateSort();
+  const Term m1 = tf.CreateTerm(sf.CreateName(s));
+  const Term m2 = tf.CreateTerm(sf.CreateName(s));
+  const Term m3 = tf.CreateTerm(sf.CreateName(s));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s));
+  const Term y = tf.CreateTerm(sf.CreateVariable(s));
+  const Symbol f = sf.CreateFunction(s, 1);
+  const Symbol g = sf.CreateFunction(s, 2);
+  const Term fx = tf.CreateTerm(f, {x});
+  const Clause c{Literal::Eq(tf.CreateTerm(g, {fx, y}), m1), Literal::Neq(fx, y), Literal::Eq(tf.CreateTerm(f, {m2}), x)};
+  const Term::Vector ns{m1, m2, m3};
+  {
+    const Grounder::Plan<Clause> plan(c);
+    EXPECT_EQ(plan.vars().size(), 2u);
+    std::vector<Clause> expected;
+    for (const Term n1 : ns) {
+      for (const Term n2 : ns) {
+        expected.push_back(c.Substitute([&plan, n1, n2](Term z) {
+          return z == plan.vars()[0] ? internal::Just(n1) : z == plan.vars()[1] ? internal::Just(n2) : internal::Nothing;
+        }, &tf));
+      }
+    }
+    std::vector<Clause> actual;
+    EXPECT_TRUE(plan.Ground(&tf, [&ns](size_t) -> const Term::Vector& { return ns; }, [&actual](const Clause& c) {
+      actual.push_back(c);
+      return true;
+    }));
+    EXPECT_EQ(actual, expected);
+    actual.clear();
+    EXPECT_FALSE(plan.Ground(&tf, [&ns](size_t) -> const Term::Vector& { return ns; }, [&actual](const Clause& c) {
+      actual.push_back(c);
+      return actual.size() < 2;
+    }));
+    EXPECT_EQ(actual.size(), 2u);
+    // With a memo, the groundings are the same, and the second round finds all
+    // nodes in the memo.
+    Term::SubstitutionMemo memo;
+    for (size_t r = 0; r < 2; ++r) {
+      actual.clear();
+      EXPECT_TRUE(plan.Ground(&tf, [&ns](size_t) -> const Term::Vector& { return ns; }, [&actual](const Clause& c) {
+        actual.push_back(c);
+        return true;
+      }, &memo));
+      EXPECT_EQ(actual, expected);
+      // f(x) is created once per name of x, g(f(x),y) once per grounding.
+      EXPECT_EQ(memo.n_hits(), r * (3u + 3u * 3u));
+      EXPECT_EQ(memo.n_misses(), 3u + 3u * 3u);
+    }
+    // The nodes are keyed like Substitute() keys terms.
+    Term::Substitution theta(x, m2);
+    theta.Add(y, m3);
+    EXPECT_EQ(tf.CreateTerm(g, {fx, y}).Substitute(memo.Memoize(theta, &tf), &tf),
+              tf.CreateTerm(g, {tf.CreateTerm(f, {m2}), m3}));
+    EXPECT_EQ(memo.n_hits(), 3u + 3u * 3u + 1u);
+    const Term::Vector none;
+    EXPECT_TRUE(plan.Ground(&tf, [&ns, &none](size_t i) -> const Term::Vector& { return i == 0 ? ns : none; },
+                            [](const Clause&) { ADD_FAILURE(); return true; }));
+  }
+  {
+    const Grounder::Plan<Literal> plan(Literal::Neq(fx, m3));
+    std::vector<Literal> actual;
+    plan.Ground(&tf, [&ns](size_t) -> const Term::Vector& { return ns; }, [&actual](Literal a) {
+      actual.push_back(a);
+      return true;
+    });
+    EXPECT_EQ(actual, std::vector<Literal>({Literal::Neq(tf.CreateTerm(f, {m1}), m3),
+                                            Literal::Neq(tf.CreateTerm(f, {m2}), m3),
+                                            Literal::Neq(tf.CreateTerm(f, {m3}), m3)}));
+  }
+  {
+    const Grounder::Plan<Term> plan(tf.CreateTerm(f, {m1}));
+    EXPECT_TRUE(plan.vars().empty());
+    std::vector<Term> actual;
+    plan.Ground(&tf, [](size_t) -> const Term::Vector& { std::abort(); }, [&actual](Term t) {
+      actual.push_back(t);
+      return true;
+    });
+    EXPECT_EQ(actual, std::vector<Term>({tf.CreateTerm(f, {m1})}));
+  }
+}
+
+TEST(GrounderTest, NewGroundings) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort Bool = sf.CreateSort();
+  const Symbol::Sort s = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(Bool));
+  const Term m = tf.CreateTerm(sf.CreateName(s));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s));
+  const Term y = tf.CreateTerm(sf.CreateVariable(s));
+  const Symbol P = sf.CreateFunction(Bool, 2);
+  const Symbol Q = sf.CreateFunction(Bool, 1);
+  Grounder g(&sf, &tf);
+  g.set_memo_slots(1 << 10);
+  // P(x,y) = T v Q(x) = T is grounded for three plus-names.
+  g.AddClause(Clause{Literal::Eq(tf.CreateTerm(P, {x, y}), T), Literal::Eq(tf.CreateTerm(Q, {x}), T)});
+  EXPECT_EQ(length(g.names(s)), 3u);
+  EXPECT_EQ(g.n_generated_clauses(), 3u * 3u);
+  EXPECT_EQ(g.n_added_clauses(), 3u * 3u);
+  // The new name m only leads to the 4*4 - 3*3 groundings that mention m,
+  // plus the unit clause itself.
+  g.AddClause(Clause{Literal::Eq(tf.CreateTerm(Q, {m}), T)});
+  EXPECT_EQ(length(g.names(s)), 4u);
+  EXPECT_EQ(g.n_generated_clauses(), 3u * 3u + 4u * 4u - 3u * 3u + 1u);
+  EXPECT_LE(g.n_added_clauses(), g.n_generated_clauses());
+  // Q(x) was created for the old names before.
+  EXPECT_GT(g.n_memo_hits(), 0u);
+  ClauseSet expected;
+  for (const Term n1 : g.names(s)) {
+    for (const Term n2 : g.names(s)) {
+      expected.insert(Clause{Literal::Eq(tf.CreateTerm(P, {n1, n2}), T), Literal::Eq(tf.CreateTerm(Q, {n1}), T)});
+    }
+  }
+  expected.insert(Clause{Literal::Eq(tf.CreateTerm(Q, {m}), T)});
+  for (const Clause& c : expected) {
+    EXPECT_TRUE(g.setup().Subsumes(c));
+  }
+}
+
+TEST(GrounderTest, RelevanceClosure) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort Bool = sf.CreateSort();
+  const Term T = tf.CreateTerm(sf.CreateName(Bool));
+  std::vector<Term> ps;
+  for (size_t i = 0; i < 50; ++i) {
+    ps.push_back(tf.CreateTerm(sf.CreateFunction(Bool, 0)));
+  }
+  const Term Q = tf.CreateTerm(sf.CreateFunction(Bool, 0));
+  const Term R = tf.CreateTerm(sf.CreateFunction(Bool, 0));
+  // The chain P49 = T v P48 = T, ..., P1 = T v P0 = T is relevant for P0, but
+  // Q = T v R = T is not. The chain's clauses are added in reverse order, so
+  // each of them becomes relevant only after the previous one.
+  std::vector<Clause> cs;
+  for (size_t i = ps.size() - 1; i > 0; --i) {
+    cs.push_back(Clause{Literal::Eq(ps[i], T), Literal::Eq(ps[i-1], T)});
+  }
+  cs.push_back(Clause{Literal::Eq(Q, T), Literal::Eq(R, T)});
+  Grounder g(&sf, &tf);
+  g.AddClauses(cs.begin(), cs.end());
+  Grounder::Undo undo;
+  g.GuaranteeConsistency(ps[0], &undo);
+  EXPECT_EQ(length(g.setup().clauses()), ps.size() - 1);
+  for (size_t i = 0; i + 1 < cs.size(); ++i) {
+    EXPECT_TRUE(g.setup().Subsumes(cs[i]));
+  }
+  EXPECT_FALSE(g.setup().Subsumes(cs.back()));
+}
+
 #if 0
 TEST(GrounderTest, Ground_SplitTerms_Names) {
   Symbol::Factory& sf = *Symbol::Factory::Instance();
@@ -3,6 +3,9 @@
 
 #include <cstdint>
 
+#include <algorithm>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <limbo/internal/hash.h>
@@ -30,6 +33,51 @@ TEST(HashTest, hash) {
   }
 }
 
+TEST(HashTest, murmur) {
+  std::vector<uint64_t> ints;
+  for (uint64_t i = 0, n = 1; i <= 19; ++i, n *= 10UL) {
+    ints.push_back(n);
+    ints.push_back(n + 1);
+  }
+  for (uint64_t i1 : ints) {
+    EXPECT_EQ(MurmurHash2(i1, 0), MurmurHash2(i1, 0));
+    EXPECT_EQ(murmur64a_hash(i1), murmur64a_hash(i1));
+    for (uint64_t i2 : ints) {
+      if (i1 != i2) {
+        EXPECT_NE(MurmurHash2(i1, 0), MurmurHash2(i2, 0));
+        EXPECT_NE(murmur64a_hash(i1), murmur64a_hash(i2));
+      }
+    }
+  }
+  const char bytes[7] = {1, 2, 3, 4, 5, 6, 7};
+  char other[7] = {1, 2, 3, 4, 5, 6, 8};
+  EXPECT_NE(MurmurHash2(bytes, 0), MurmurHash2(other, 0));
+  EXPECT_NE(murmur64a_hash(bytes), murmur64a_hash(other));
+}
+
+TEST(HashTest, combine) {
+  auto hash = [](std::vector<u32> vs) {
+    hash32_t h = 0;
+    for (u32 v : vs) {
+      h = murmur3_combine(h, v);
+    }
+    return murmur3_finalize(h, vs.size());
+  };
+  EXPECT_EQ(hash({1, 2}), hash({1, 2}));
+  EXPECT_NE(hash({1, 2}), hash({2, 1}));
+  EXPECT_NE(hash({1, 1}), hash({2, 2}));
+  EXPECT_NE(hash({1}), hash({1, 0}));
+  // The low bits of the hashes of a 32x32 grid are spread over all buckets.
+  constexpr size_t kBuckets = 1024;
+  std::vector<size_t> buckets(kBuckets);
+  for (u32 i = 0; i < 32; ++i) {
+    for (u32 j = 0; j < 32; ++j) {
+      ++buckets[hash({i, j}) % kBuckets];
+    }
+  }
+  EXPECT_LE(*std::max_element(buckets.begin(), buckets.end()), 8u);
+}
+
 }  // namespace internal
 }  // namespace limbo
 
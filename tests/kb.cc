@@ -74,5 +74,39 @@ TEST(KnowledgeBaseTest, ECAI2016Sound_NoGuarantee) {
   EXPECT_TRUE(kb.Entails(*Formula::Factory::Bel(1, 1, *(Italian != T), *(Veggie != T))));
 }
 
+TEST(KnowledgeBaseTest, SeparateFactories) {
+  Symbol::Factory sf1;
+  Symbol::Factory sf2;
+  Term::Factory tf1;
+  Term::Factory tf2;
+  KnowledgeBase kb1(&sf1, &tf1);
+  KnowledgeBase kb2(&sf2, &tf2);
+  for (size_t k = 0; k < 2; ++k) {
+    Symbol::Factory* sf = k == 0 ? &sf1 : &sf2;
+    Term::Factory* tf = k == 0 ? &tf1 : &tf2;
+    KnowledgeBase* kb = k == 0 ? &kb1 : &kb2;
+    Clause c;
+    Formula::Ref phi;
+    Formula::Ref psi;
+    {
+      Term::Factory::Context ctx(tf);
+      const Symbol::Sort s = sf->CreateSort();
+      const Symbol f = sf->CreateFunction(s, 1);
+      const Term x = tf->CreateTerm(sf->CreateVariable(s));
+      const Term n = tf->CreateTerm(sf->CreateName(s));
+      const Term m = tf->CreateTerm(sf->CreateName(s));
+      if (k == 1) {
+        tf->CreateTerm(f, {m});
+      }
+      c = Clause{Literal::Eq(tf->CreateTerm(f, {x}), n)};
+      phi = Formula::Factory::Know(0, Formula::Factory::Atomic(Clause{Literal::Eq(tf->CreateTerm(f, {m}), n)}));
+      psi = Formula::Factory::Know(0, Formula::Factory::Atomic(Clause{Literal::Eq(tf->CreateTerm(f, {m}), m)}));
+    }
+    kb->Add(c);
+    EXPECT_TRUE(kb->Entails(*phi));
+    EXPECT_FALSE(kb->Entails(*psi));
+  }
+}
+
 }  // namespace limbo
 
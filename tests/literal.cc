@@ -1,6 +1,10 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2014 Christoph Schwering
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <limbo/literal.h>
@@ -93,5 +97,56 @@ TEST(LiteralTest, general) {
   EXPECT_TRUE(Literal::Valid(Literal::Neq(f1, n1), Literal::Neq(f1, n2)));
 }
 
+TEST(LiteralTest, SubsumesAny) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  std::vector<Term> names;
+  std::vector<Term> funcs;
+  for (int i = 0; i < 3; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(s1)));
+    funcs.push_back(tf.CreateTerm(sf.CreateFunction(s1, 0), {}));
+  }
+  std::vector<Literal> lits;
+  for (const Term f : funcs) {
+    for (const Term n : names) {
+      lits.push_back(Literal::Eq(f,n));
+      lits.push_back(Literal::Neq(f,n));
+    }
+  }
+  std::vector<internal::SubsumesAnyFunction> kernels = {internal::SubsumesAnyScalar};
+#ifdef LIMBO_SIMD_X86
+  if (__builtin_cpu_supports("sse4.1")) {
+    kernels.push_back(internal::SubsumesAnySse41);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back(internal::SubsumesAnyAvx2);
+  }
+#endif
+  for (size_t n = 0; n <= 3; ++n) {
+    for (size_t j = 0; j + n <= lits.size(); ++j) {
+      const Literal* bs = lits.data() + j;
+      std::vector<char> expected;
+      for (const Literal a : lits) {
+        expected.push_back(std::any_of(bs, bs + n, [a](Literal b) { return a.Subsumes(b); }));
+      }
+      std::unique_ptr<bool[]> out(new bool[lits.size()]);
+      for (const internal::SubsumesAnyFunction f : kernels) {
+        for (size_t m = 0; m <= lits.size(); m += 5) {
+          f(reinterpret_cast<const internal::u64*>(lits.data()), m, reinterpret_cast<const internal::u64*>(bs), n,
+            out.get());
+          for (size_t i = 0; i < m; ++i) {
+            EXPECT_EQ(out[i], expected[i] != 0);
+          }
+        }
+      }
+      Literal::SubsumesAny(lits.data(), lits.size(), bs, n, out.get());
+      for (size_t i = 0; i < lits.size(); ++i) {
+        EXPECT_EQ(out[i], expected[i] != 0);
+      }
+    }
+  }
+}
+
 }  // namespace limbo
 
@@ -0,0 +1,112 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <limbo/internal/pool.h>
+
+namespace limbo {
+namespace internal {
+
+TEST(PoolTest, Capacity) {
+  typedef Pool<u64> P;
+  EXPECT_EQ(P::Capacity(1), 1u);
+  EXPECT_EQ(P::Capacity(2), 2u);
+  EXPECT_EQ(P::Capacity(3), 4u);
+  EXPECT_EQ(P::Capacity(17), 32u);
+  EXPECT_EQ(P::Capacity(P::kMaxPooled), P::kMaxPooled);
+  EXPECT_EQ(P::Capacity(P::kMaxPooled + 1), P::kMaxPooled + 1);
+}
+
+TEST(PoolTest, reuse) {
+  typedef Pool<u64> P;
+  u64* a = P::Allocate(P::Capacity(3));
+  u64* b = P::Allocate(P::Capacity(9));
+  for (size_t i = 0; i < 4; ++i) {
+    a[i] = i;
+  }
+  P::Release(a, P::Capacity(3));
+  EXPECT_EQ(P::Allocate(P::Capacity(4)), a);
+  u64* c = P::Allocate(P::Capacity(4));
+  EXPECT_NE(c, a);
+  P::Release(b, P::Capacity(9));
+  P::Release(c, P::Capacity(4));
+  EXPECT_EQ(P::Allocate(P::Capacity(3)), c);
+  EXPECT_EQ(P::Allocate(P::Capacity(16)), b);
+  P::Release(a, P::Capacity(4));
+  P::Release(b, P::Capacity(16));
+  P::Release(c, P::Capacity(4));
+  u64* d = P::Allocate(P::Capacity(P::kMaxPooled + 1));
+  P::Release(d, P::Capacity(P::kMaxPooled + 1));
+}
+
+TEST(PoolTest, threads) {
+  typedef Pool<u64> P;
+  std::vector<u64*> arrays;
+  for (size_t i = 1; i <= 100; ++i) {
+    arrays.push_back(P::Allocate(P::Capacity(i)));
+  }
+  std::thread t([&arrays]() {
+    for (size_t i = 1; i <= 100; ++i) {
+      P::Release(arrays[i - 1], P::Capacity(i));
+      arrays[i - 1] = P::Allocate(P::Capacity(i));
+      arrays[i - 1][i - 1] = i;
+    }
+  });
+  t.join();
+  for (size_t i = 1; i <= 100; ++i) {
+    EXPECT_EQ(arrays[i - 1][i - 1], i);
+    P::Release(arrays[i - 1], P::Capacity(i));
+  }
+}
+
+TEST(PoolTest, cross_thread_release) {
+  typedef Pool<u64> P;
+  const size_t capacity = P::Capacity(P::kMaxPooled);
+  const size_t n = P::MaxRetained(capacity);
+  const i64 bytes = PoolStats::kEnabled ? capacity * sizeof(u64) : 0;
+  PoolStats* stats = PoolStats::Instance();
+  std::vector<u64*> arrays;
+  for (size_t i = 0; i < n + 10; ++i) {
+    arrays.push_back(P::Allocate(capacity));
+    arrays.back()[capacity - 1] = i;
+  }
+  const i64 retained = stats->retained();
+  std::thread t([&]() {
+    for (u64* a : arrays) {
+      P::Release(a, capacity);
+    }
+    EXPECT_EQ(stats->retained(), retained + static_cast<i64>(n) * bytes);
+    u64* a = P::Allocate(capacity);
+    EXPECT_NE(std::find(arrays.begin(), arrays.end(), a), arrays.end());
+    EXPECT_EQ(stats->retained(), retained + static_cast<i64>(n - 1) * bytes);
+    P::Release(a, capacity);
+  });
+  t.join();
+  EXPECT_EQ(stats->retained(), retained);
+}
+
+TEST(PoolTest, stats) {
+  typedef Pool<i64> P;
+  PoolStats* stats = PoolStats::Instance();
+  stats->Reset();
+  P::Release(P::Allocate(P::Capacity(5)), P::Capacity(5));
+  P::Release(P::Allocate(P::Capacity(6)), P::Capacity(6));
+  PoolStats::RecordSize(3);
+  PoolStats::RecordSize(PoolStats::kSizes + 10);
+  const u64 n = PoolStats::kEnabled ? 1 : 0;
+  EXPECT_EQ(stats->allocations(), 2 * n);
+  EXPECT_EQ(stats->reuses(), n);
+  EXPECT_EQ(stats->sizes(3), n);
+  EXPECT_EQ(stats->sizes(4), 0u);
+  EXPECT_EQ(stats->sizes(PoolStats::kSizes - 1), n);
+  stats->Reset();
+  EXPECT_EQ(stats->allocations(), 0u);
+}
+
+}  // namespace internal
+}  // namespace limbo
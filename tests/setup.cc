@@ -1,7 +1,9 @@
 // vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
 // Copyright 2014 Christoph Schwering
 
+#include <algorithm>
 #include <array>
+#include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -35,7 +37,7 @@ TEST(SetupTest, Subsumes_Consistent_clauses) {
     EXPECT_TRUE(s0.Consistent());
     EXPECT_TRUE(s0.LocallyConsistent({fm,fn}));
     for (size_t i : s0.clauses()) {
-      EXPECT_TRUE(s0.Subsumes(s0.clause(i)));
+      EXPECT_TRUE(s0.Subsumes(Clause(s0.clause(i))));
     }
     EXPECT_FALSE(s0.Subsumes(Clause({Literal::Eq(a,m), Literal::Eq(a,n)})));
 
@@ -50,7 +52,7 @@ TEST(SetupTest, Subsumes_Consistent_clauses) {
       EXPECT_EQ(dist(s1.clauses()), 4);
       EXPECT_TRUE(!s1.Consistent());
       for (const size_t i : s1.clauses()) {
-        EXPECT_TRUE(s1.Subsumes(s1.clause(i)));
+        EXPECT_TRUE(s1.Subsumes(Clause(s1.clause(i))));
       }
       EXPECT_FALSE(s1.Subsumes(Clause({Literal::Eq(a,m), Literal::Eq(a,n)})));
 
@@ -60,7 +62,7 @@ TEST(SetupTest, Subsumes_Consistent_clauses) {
         EXPECT_EQ(dist(s2.clauses()), 5);
         EXPECT_TRUE(!s2.Consistent());
         for (const size_t i : s2.clauses()) {
-          EXPECT_TRUE(s2.Subsumes(s2.clause(i)));
+          EXPECT_TRUE(s2.Subsumes(Clause(s2.clause(i))));
         }
 
         {
@@ -76,5 +78,434 @@ TEST(SetupTest, Subsumes_Consistent_clauses) {
   }
 }
 
+TEST(SetupTest, ShallowCopy_propagation) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,n), Literal::Eq(b,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(b,n), Literal::Eq(c,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(a,m), Literal::Neq(b,m), Literal::Eq(c,m)})), limbo::Setup::kOk);
+  EXPECT_FALSE(s0.Determines(a));
+  EXPECT_FALSE(s0.Determines(c));
+  for (int round = 0; round < 2; ++round) {
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Eq(a,n)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Determines(b) && s1.setup().Determines(b).val == n);
+      EXPECT_TRUE(s1.setup().Determines(c) && s1.setup().Determines(c).val == n);
+      {
+        limbo::Setup::ShallowCopy s2 = s1.setup().shallow_copy();
+        EXPECT_EQ(s2.AddUnit(Literal::Neq(c,n)), limbo::Setup::kInconsistent);
+        EXPECT_TRUE(s2.setup().contains_empty_clause());
+      }
+      EXPECT_FALSE(s1.setup().contains_empty_clause());
+      EXPECT_TRUE(s1.setup().Determines(c) && s1.setup().Determines(c).val == n);
+    }
+    EXPECT_FALSE(s0.Determines(b));
+    EXPECT_FALSE(s0.Determines(c));
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Eq(a,m)), limbo::Setup::kOk);
+      EXPECT_FALSE(s1.setup().Determines(c));
+      EXPECT_EQ(s1.AddUnit(Literal::Eq(b,m)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Determines(c) && s1.setup().Determines(c).val == m);
+    }
+    EXPECT_FALSE(s0.Determines(c));
+  }
+}
+
+TEST(SetupTest, ShallowCopy_propagation_same_lhs) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term o = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  // Both watched literals of the clauses may have lhs a, before or after
+  // propagation.
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(a,m), Literal::Eq(a,o)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(a,m), Literal::Eq(b,n)})), limbo::Setup::kOk);
+  for (int round = 0; round < 2; ++round) {
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(a,n)), limbo::Setup::kOk);
+      EXPECT_FALSE(s1.setup().Determines(a));
+      EXPECT_FALSE(s1.setup().Determines(b));
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(a,m)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Determines(a) && s1.setup().Determines(a).val == o);
+      EXPECT_TRUE(s1.setup().Determines(b) && s1.setup().Determines(b).val == n);
+    }
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(b,n)), limbo::Setup::kOk);
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(a,o)), limbo::Setup::kOk);
+      EXPECT_FALSE(s1.setup().Determines(a));
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(a,m)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Determines(a) && s1.setup().Determines(a).val == n);
+    }
+    EXPECT_FALSE(s0.Determines(a));
+    EXPECT_FALSE(s0.Determines(b));
+  }
+}
+
+TEST(SetupTest, ForEachSubsumed) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  auto subsumed = [](const limbo::Setup& s, const Clause& c) {
+    std::vector<Clause> cs;
+    s.ForEachSubsumed(c, [&s, &cs](size_t i) { cs.push_back(Clause(s.clause(i))); });
+    return cs;
+  };
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(b,n), Literal::Eq(c,n)})), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(b,m)})), limbo::Setup::kOk);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(a,n), Literal::Eq(b,n)})).size(), 2);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(b,n), Literal::Eq(c,n)})).size(), 2);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(a,n), Literal::Eq(c,n)})).size(), 1);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(b,n)})).size(), 4);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(c,m)})).size(), 0);
+  {
+    limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+    EXPECT_EQ(s1.AddUnit(Literal::Neq(a,n)), limbo::Setup::kOk);
+    EXPECT_EQ(subsumed(s1.setup(), Clause({Literal::Eq(b,n)})).size(), 5);
+    EXPECT_EQ(subsumed(s1.setup(), Clause({Literal::Eq(b,n), Literal::Eq(c,n)})).size(), 2);
+    EXPECT_TRUE(s1.setup().Subsumes(Clause({Literal::Eq(b,n)})));
+    EXPECT_EQ(s1.AddClause(Clause({Literal::Eq(c,m), Literal::Eq(a,m)})), limbo::Setup::kOk);
+    EXPECT_EQ(subsumed(s1.setup(), Clause({Literal::Eq(c,m)})).size(), 1);
+  }
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(c,m)})).size(), 0);
+  EXPECT_FALSE(s0.Subsumes(Clause({Literal::Eq(b,n)})));
+  s0.Minimize();
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)})).size(), 0);
+  EXPECT_EQ(subsumed(s0, Clause({Literal::Eq(a,n), Literal::Eq(b,n)})).size(), 1);
+  for (size_t i : s0.clauses()) {
+    EXPECT_TRUE(s0.Subsumes(Clause(s0.clause(i))));
+  }
+}
+
+TEST(SetupTest, Units) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term k = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddUnit(Literal::Neq(a,n)), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddUnit(Literal::Neq(a,m)), limbo::Setup::kOk);
+  EXPECT_EQ(s0.AddUnit(Literal::Neq(a,n)), limbo::Setup::kSubsumed);
+  EXPECT_FALSE(s0.Determines(a));
+  EXPECT_TRUE(s0.Subsumes(Clause({Literal::Neq(a,m)})));
+  EXPECT_FALSE(s0.Subsumes(Clause({Literal::Neq(a,k)})));
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(a,m), Literal::Eq(b,n)})), limbo::Setup::kOk);
+  EXPECT_TRUE(s0.Determines(b) && s0.Determines(b).val == n);
+  {
+    limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+    EXPECT_EQ(s1.AddUnit(Literal::Eq(a,n)), limbo::Setup::kInconsistent);
+  }
+  EXPECT_FALSE(s0.contains_empty_clause());
+  {
+    limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+    EXPECT_EQ(s1.AddUnit(Literal::Eq(a,k)), limbo::Setup::kOk);
+    EXPECT_TRUE(s1.setup().Determines(a) && s1.setup().Determines(a).val == k);
+    EXPECT_TRUE(s1.setup().Subsumes(Clause({Literal::Neq(a,n)})));
+    EXPECT_EQ(s1.AddUnit(Literal::Neq(a,n)), limbo::Setup::kSubsumed);
+    EXPECT_EQ(s1.AddUnit(Literal::Eq(a,m)), limbo::Setup::kInconsistent);
+  }
+  EXPECT_FALSE(s0.Determines(a));
+  EXPECT_EQ(dist(s0.clauses()), 3);
+  EXPECT_EQ(s0.AddUnit(Literal::Eq(a,k)), limbo::Setup::kOk);
+  s0.Minimize();
+  EXPECT_EQ(dist(s0.clauses()), 2);
+  EXPECT_TRUE(s0.Determines(a) && s0.Determines(a).val == k);
+  EXPECT_TRUE(s0.Determines(b) && s0.Determines(b).val == n);
+}
+
+TEST(SetupTest, Consistent_incremental) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  limbo::Setup s0;
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n)})), limbo::Setup::kOk);
+  EXPECT_TRUE(s0.Consistent());
+  EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(a,m), Literal::Eq(c,n)})), limbo::Setup::kOk);
+  EXPECT_FALSE(s0.Consistent());
+  EXPECT_FALSE(s0.LocallyConsistent({a}));
+  EXPECT_TRUE(s0.LocallyConsistent({b}));
+  EXPECT_FALSE(s0.LocallyConsistent({b,c}));
+  for (int round = 0; round < 2; ++round) {
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Neq(a,m)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Consistent());
+      EXPECT_TRUE(s1.setup().LocallyConsistent({a,b,c}));
+      {
+        limbo::Setup::ShallowCopy s2 = s1.setup().shallow_copy();
+        EXPECT_EQ(s2.AddClause(Clause({Literal::Neq(b,n), Literal::Eq(b,m)})), limbo::Setup::kOk);
+        EXPECT_FALSE(s2.setup().Consistent());
+        EXPECT_TRUE(s2.setup().LocallyConsistent({a}));
+      }
+      EXPECT_TRUE(s1.setup().Consistent());
+    }
+    EXPECT_FALSE(s0.Consistent());
+    {
+      limbo::Setup::ShallowCopy s1 = s0.shallow_copy();
+      EXPECT_EQ(s1.AddUnit(Literal::Eq(a,n)), limbo::Setup::kOk);
+      EXPECT_TRUE(s1.setup().Consistent());
+      s1.Minimize();
+      EXPECT_TRUE(s1.setup().Consistent());
+    }
+    EXPECT_FALSE(s0.Consistent());
+  }
+}
+
+TEST(SetupTest, Minimize_parallel) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const std::vector<Clause> cs = {
+    Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}),
+    Clause({Literal::Eq(a,n), Literal::Eq(b,n)}),
+    Clause({Literal::Eq(b,m), Literal::Eq(c,m)}),
+    Clause({Literal::Eq(a,n), Literal::Eq(b,n)}),
+    Clause({Literal::Eq(a,m), Literal::Neq(c,n)}),
+    Clause({Literal::Eq(b,m), Literal::Eq(c,m), Literal::Eq(a,n)}),
+    Clause({Literal::Neq(c,m)}),
+  };
+
+  for (size_t n_threads = 1; n_threads <= 4; ++n_threads) {
+    limbo::Setup s0;
+    limbo::Setup s1;
+    for (const Clause& c : cs) {
+      s0.AddClause(c);
+      s1.AddClause(c);
+    }
+    s0.Minimize();
+    s1.Minimize(n_threads);
+    EXPECT_EQ(dist(s0.clauses()), 4);
+    EXPECT_EQ(dist(s1.clauses()), 4);
+    for (size_t i : s0.clauses()) {
+      EXPECT_EQ(s0.clause(i), s1.clause(i));
+    }
+  }
+}
+
+TEST(SetupTest, Minimize_parallel_factory) {
+  Symbol::Factory sf;
+  Term::Factory tf;
+  Symbol::Factory::Context sctx(&sf);
+  Term::Factory::Context tctx(&tf);
+  const Symbol::Sort sort = sf.CreateSort(); RegisterSort(sort, "");
+  std::vector<Term> names;
+  std::vector<Term> funcs;
+  for (size_t i = 0; i < 3; ++i) {
+    names.push_back(tf.CreateTerm(sf.CreateName(sort)));
+  }
+  for (size_t i = 0; i < 6; ++i) {
+    funcs.push_back(tf.CreateTerm(sf.CreateFunction(sort, 0), {}));
+  }
+  // Positive literals with distinct lhs keep the clauses non-unit and the
+  // setup consistent, so Minimize() has to test every clause.
+  std::mt19937 gen(1);
+  std::vector<Clause> cs;
+  for (size_t i = 0; i < 200; ++i) {
+    std::vector<Term> lhs = funcs;
+    std::shuffle(lhs.begin(), lhs.end(), gen);
+    std::vector<Literal> lits;
+    for (size_t j = 2 + gen() % 3; j > 0; --j) {
+      lits.push_back(Literal::Eq(lhs[j], names[gen() % names.size()]));
+    }
+    cs.push_back(Clause(lits.begin(), lits.end()));
+  }
+
+  // The workers must resolve terms through tf, not the global factory.
+  limbo::Setup s0;
+  limbo::Setup s1;
+  for (const Clause& c : cs) {
+    s0.AddClause(c);
+    s1.AddClause(c);
+  }
+  s0.Minimize();
+  s1.Minimize(4);
+  EXPECT_EQ(dist(s0.clauses()), dist(s1.clauses()));
+  for (size_t i : s0.clauses()) {
+    EXPECT_EQ(s0.clause(i), s1.clause(i));
+  }
+}
+
+TEST(SetupTest, Minimize_shallow_copies) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  auto clauses_of = [](const limbo::Setup& s) {
+    std::vector<Clause> cs;
+    for (size_t i : s.clauses()) {
+      cs.push_back(Clause(s.clause(i)));
+    }
+    return cs;
+  };
+
+  limbo::Setup s;
+  s.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}));
+  s.AddClause(Clause({Literal::Eq(b,m), Literal::Eq(c,m)}));
+  const std::vector<Clause> cs0 = clauses_of(s);
+  {
+    limbo::Setup::ShallowCopy sc1 = s.shallow_copy();
+    sc1.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n)}));
+    sc1.AddClause(Clause({Literal::Eq(a,m), Literal::Neq(c,n)}));
+    const std::vector<Clause> cs1 = clauses_of(s);
+    EXPECT_EQ(cs1.size(), 4);
+    {
+      limbo::Setup::ShallowCopy sc2 = s.shallow_copy();
+      sc2.AddUnit(Literal::Neq(c,m));
+      EXPECT_TRUE(s.Consistent());
+      sc2.AddUnit(Literal::Neq(b,m));
+      EXPECT_FALSE(s.Consistent());
+      EXPECT_TRUE(s.contains_empty_clause());
+      sc2.Kill();
+      EXPECT_EQ(clauses_of(s), cs1);
+    }
+    {
+      limbo::Setup::ShallowCopy sc2 = s.shallow_copy();
+      sc2.AddUnit(Literal::Neq(c,m));
+      // Minimizes clauses that sc1 and sc2 refer to.
+      s.Minimize();
+      EXPECT_EQ(dist(s.clauses()), 4);
+      EXPECT_EQ(s.Determines(b), internal::Just(m));
+      EXPECT_TRUE(s.Consistent());
+      sc2.Kill();
+      EXPECT_EQ(clauses_of(s), cs1);
+      EXPECT_FALSE(s.Determines(b));
+    }
+    {
+      limbo::Setup::ShallowCopy sc2 = s.shallow_copy();
+      sc2.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,m)}));
+      sc1.Minimize();
+      EXPECT_EQ(dist(s.clauses()), 4);
+      sc2.Kill();
+      EXPECT_EQ(clauses_of(s), cs1);
+    }
+    sc1.Minimize();
+    EXPECT_EQ(clauses_of(s), cs1);
+  }
+  EXPECT_EQ(clauses_of(s), cs0);
+}
+
+TEST(SetupTest, ClauseView) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  limbo::Setup s;
+  s.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}));
+  EXPECT_EQ(dist(s.clauses()), 1);
+  EXPECT_EQ(s.clause(0).size(), 3);
+  EXPECT_EQ(Clause(s.clause(0)), Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}));
+  {
+    limbo::Setup::ShallowCopy sc = s.shallow_copy();
+    sc.AddUnit(Literal::Eq(b,m));
+    EXPECT_EQ(dist(s.clauses()), 2);
+    const limbo::Setup::ClauseView u = s.clause(0);
+    const limbo::Setup::ClauseView v = s.clause(1);
+    EXPECT_TRUE(u.unit());
+    EXPECT_EQ(u.first(), Literal::Eq(b,m));
+    EXPECT_EQ(v.size(), 2);
+    EXPECT_FALSE(v.unit());
+    EXPECT_FALSE(v.valid());
+    EXPECT_TRUE(v.ground() && v.primitive());
+    EXPECT_FALSE(v.any([b](Literal x) { return x.lhs() == b; }));
+    EXPECT_EQ(std::vector<Literal>(v.begin(), v.end()), std::vector<Literal>({Literal::Eq(a,n), Literal::Eq(c,n)}));
+    EXPECT_EQ(Clause(v), Clause({Literal::Eq(a,n), Literal::Eq(c,n)}));
+    EXPECT_EQ(v, s.clause(1));
+    EXPECT_NE(u, v);
+    sc.AddUnit(Literal::Eq(a,m));
+    EXPECT_TRUE(s.clause(2).unit());
+    sc.AddUnit(Literal::Neq(c,n));
+    EXPECT_TRUE(s.clause(0).empty());
+  }
+  EXPECT_EQ(s.clause(0).size(), 3);
+}
+
+TEST(SetupTest, ClauseView_cache) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term m = tf.CreateTerm(sf.CreateName(s1));
+  const Term a = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term b = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0), {});
+
+  limbo::Setup s;
+  s.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}));
+  const size_t g = s.generation();
+  EXPECT_EQ(s.CachedClause(0).size(), 3);
+  EXPECT_EQ(s.n_cache_misses(), 1);
+  EXPECT_EQ(s.CachedClause(0).size(), 3);
+  EXPECT_EQ(s.n_cache_hits(), 1);
+  EXPECT_EQ(s.generation(), g);
+  {
+    limbo::Setup::ShallowCopy sc = s.shallow_copy();
+    sc.AddClause(Clause({Literal::Eq(a,n), Literal::Eq(b,m)}));
+    EXPECT_EQ(s.generation(), g);
+    sc.AddUnit(Literal::Eq(b,m));
+    EXPECT_NE(s.generation(), g);
+    EXPECT_EQ(Clause(s.CachedClause(1)), Clause({Literal::Eq(a,n), Literal::Eq(c,n)}));
+    EXPECT_EQ(s.n_cache_misses(), 2);
+    EXPECT_EQ(Clause(s.CachedClause(1)), Clause({Literal::Eq(a,n), Literal::Eq(c,n)}));
+    EXPECT_EQ(s.n_cache_hits(), 2);
+  }
+  EXPECT_EQ(Clause(s.CachedClause(0)), Clause({Literal::Eq(a,n), Literal::Eq(b,n), Literal::Eq(c,n)}));
+  EXPECT_EQ(s.n_cache_misses(), 3);
+  // clause() does not touch the cache.
+  EXPECT_EQ(s.clause(0), s.CachedClause(0));
+  EXPECT_EQ(s.n_cache_hits(), 3);
+  EXPECT_EQ(s.n_cache_misses(), 3);
+}
+
 }  // namespace limbo
 
@@ -0,0 +1,242 @@
+// vim:filetype=cpp:textwidth=120:shiftwidth=2:softtabstop=2:expandtab
+// Copyright 2017 Christoph Schwering
+
+#include <cstdio>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <limbo/format/snapshot.h>
+#include <limbo/format/output.h>
+
+namespace limbo {
+
+using namespace limbo::format;
+
+template<typename T>
+size_t dist(T r) { return std::distance(r.begin(), r.end()); }
+
+TEST(SnapshotTest, Write_Restore) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort(); RegisterSort(s1, "");
+  const Symbol nn = sf.CreateName(s1);
+  const Symbol mm = sf.CreateName(s1);
+  const Symbol ff = sf.CreateFunction(s1, 1);
+  const Symbol cc = sf.CreateFunction(s1, 0);
+  const Term n = tf.CreateTerm(nn);
+  const Term m = tf.CreateTerm(mm);
+  const Term fn = tf.CreateTerm(ff, {n});
+  const Term fm = tf.CreateTerm(ff, {m});
+  const Term c = tf.CreateTerm(cc);
+
+  std::string bytes;
+  {
+    limbo::Setup s0;
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(fn,n), Literal::Eq(fm,n), Literal::Eq(c,m)})), limbo::Setup::kOk);
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(fn,n), Literal::Eq(fm,m)})), limbo::Setup::kOk);
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(c,m)})), limbo::Setup::kOk);
+    s0.Minimize();
+    std::stringstream ss;
+    EXPECT_TRUE(Snapshot::Write(s0, &ss));
+    bytes = ss.str();
+  }
+
+  // Term ids are not preserved across processes; creating terms in a
+  // different order mimics that.
+  Term::Factory::Reset();
+  Term::Factory& tf2 = *Term::Factory::Instance();
+  const Term c2 = tf2.CreateTerm(cc);
+  const Term m2 = tf2.CreateTerm(mm);
+  const Term fm2 = tf2.CreateTerm(ff, {m2});
+  const Term n2 = tf2.CreateTerm(nn);
+  const Term fn2 = tf2.CreateTerm(ff, {n2});
+
+  std::unique_ptr<internal::u32[]> buffer(new internal::u32[bytes.size() / sizeof(internal::u32)]);
+  std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(buffer.get()));
+  {
+    Snapshot snap(buffer.get(), bytes.size());
+    EXPECT_TRUE(snap.valid());
+    EXPECT_FALSE(snap.contains_empty_clause());
+    EXPECT_EQ(snap.n_units(), 1);
+    EXPECT_EQ(snap.n_clauses(), 2);
+    limbo::Setup s1;
+    EXPECT_TRUE(snap.Restore(&sf, &tf2, &s1));
+    EXPECT_EQ(dist(s1.clauses()), 3);
+    EXPECT_TRUE(s1.Subsumes(Clause({Literal::Neq(c2,m2)})));
+    EXPECT_TRUE(s1.Subsumes(Clause({Literal::Eq(fn2,n2), Literal::Eq(fm2,n2)})));
+    EXPECT_TRUE(s1.Subsumes(Clause({Literal::Neq(fn2,n2), Literal::Eq(fm2,m2)})));
+    EXPECT_FALSE(s1.Subsumes(Clause({Literal::Eq(fn2,n2)})));
+    EXPECT_FALSE(s1.Consistent());
+    {
+      limbo::Setup::ShallowCopy s2 = s1.shallow_copy();
+      EXPECT_EQ(s2.AddUnit(Literal::Neq(fm2,n2)), limbo::Setup::kOk);
+      EXPECT_TRUE(s2.setup().Determines(fn2) && s2.setup().Determines(fn2).val == n2);
+      EXPECT_TRUE(s2.setup().Determines(fm2) && s2.setup().Determines(fm2).val == m2);
+    }
+    EXPECT_FALSE(s1.Determines(fn2));
+  }
+
+  buffer[0] ^= 1;
+  EXPECT_FALSE(Snapshot(buffer.get(), bytes.size()).valid());
+  buffer[0] ^= 1;
+  EXPECT_FALSE(Snapshot(buffer.get(), bytes.size() - sizeof(internal::u32)).valid());
+
+  const std::string path = "snapshot-test.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+  }
+  {
+    Snapshot snap = Snapshot::Read(path);
+    EXPECT_TRUE(snap.valid());
+    limbo::Setup s1;
+    EXPECT_TRUE(snap.Restore(&sf, &tf2, &s1));
+    EXPECT_EQ(dist(s1.clauses()), 3);
+  }
+  std::remove(path.c_str());
+  EXPECT_FALSE(Snapshot::Read(path).valid());
+}
+
+TEST(SnapshotTest, Restore_FreshFactories) {
+  std::string bytes;
+  Term::Vector ts;
+  {
+    Symbol::Factory sf;
+    Term::Factory tf;
+    Term::Factory::Context ctx(&tf);
+    const Symbol::Sort s1 = sf.CreateSort();
+    const Term n = tf.CreateTerm(sf.CreateName(s1));
+    const Term m = tf.CreateTerm(sf.CreateName(s1));
+    const Symbol ff = sf.CreateFunction(s1, 1);
+    const Term fn = tf.CreateTerm(ff, {n});
+    const Term fm = tf.CreateTerm(ff, {m});
+    limbo::Setup s0;
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(fn,n), Literal::Eq(fm,m)})), limbo::Setup::kOk);
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Neq(fn,m)})), limbo::Setup::kOk);
+    std::stringstream ss;
+    EXPECT_TRUE(Snapshot::Write(s0, &ss));
+    bytes = ss.str();
+  }
+
+  // A worker process has fresh factories and reads the snapshot file before
+  // it creates any symbols.
+  const std::string path = "snapshot-test-fresh.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+  }
+  Symbol::Factory sf;
+  Term::Factory tf;
+  limbo::Setup s1;
+  {
+    Snapshot snap = Snapshot::Read(path);
+    std::remove(path.c_str());
+    EXPECT_TRUE(snap.valid());
+    EXPECT_TRUE(snap.Restore(&sf, &tf, &s1));
+  }
+  EXPECT_EQ(dist(s1.clauses()), 2);
+
+  Term::Factory::Context ctx(&tf);
+  Term::Vector restored;
+  for (const Literal a : s1.units()) {
+    restored.push_back(a.lhs());
+    restored.push_back(a.lhs().arg(0));
+    restored.push_back(a.rhs());
+  }
+  for (const size_t i : s1.clauses()) {
+    for (const Literal a : s1.clause(i)) {
+      restored.push_back(a.lhs());
+      restored.push_back(a.lhs().arg(0));
+      restored.push_back(a.rhs());
+    }
+  }
+  EXPECT_FALSE(restored.empty());
+  const Symbol::Sort s2 = sf.CreateSort();
+  const Term o = tf.CreateTerm(sf.CreateName(restored[0].sort()));
+  const Term p = tf.CreateTerm(sf.CreateName(s2));
+  const Term go = tf.CreateTerm(sf.CreateFunction(restored[0].sort(), 1), {o});
+  EXPECT_NE(s2, restored[0].sort());
+  for (const Term t : restored) {
+    EXPECT_NE(t, o);
+    EXPECT_NE(t.symbol(), o.symbol());
+    EXPECT_NE(t.symbol(), p.symbol());
+    EXPECT_NE(t.symbol(), go.symbol());
+  }
+  EXPECT_TRUE(o.name() && o.symbol().sort() == restored[0].sort());
+  EXPECT_EQ(go.arg(0), o);
+}
+
+TEST(SnapshotTest, Restore_Malformed) {
+  typedef internal::u32 u32;
+  std::string bytes;
+  {
+    Symbol::Factory sf;
+    Term::Factory tf;
+    Term::Factory::Context ctx(&tf);
+    const Symbol::Sort s1 = sf.CreateSort();
+    const Term n = tf.CreateTerm(sf.CreateName(s1));
+    const Term m = tf.CreateTerm(sf.CreateName(s1));
+    const Symbol ff = sf.CreateFunction(s1, 1);
+    const Term fn = tf.CreateTerm(ff, {n});
+    const Term fm = tf.CreateTerm(ff, {m});
+    limbo::Setup s0;
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(fn,n), Literal::Eq(fm,m)})), limbo::Setup::kOk);
+    EXPECT_EQ(s0.AddClause(Clause({Literal::Eq(fn,m), Literal::Eq(fm,n)})), limbo::Setup::kOk);
+    std::stringstream ss;
+    EXPECT_TRUE(Snapshot::Write(s0, &ss));
+    bytes = ss.str();
+  }
+  std::unique_ptr<u32[]> buffer(new u32[bytes.size() / sizeof(u32)]);
+  std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(buffer.get()));
+
+  // The header consists of ten words, followed by four words per term, the
+  // arguments, two words per unit, and the clause ends.
+  const u32 n_terms = buffer[5];
+  const u32* terms = buffer.get() + 10;
+  u32* args = buffer.get() + 10 + 4 * n_terms;
+  u32* ends = args + buffer[6] + 2 * buffer[7];
+  const u32 n_clauses = buffer[8];
+  const u32 n_literals = buffer[9];
+  ASSERT_EQ(n_clauses, 2u);
+  ASSERT_EQ(n_literals, 4u);
+  auto restores = [&]() {
+    Symbol::Factory sf;
+    Term::Factory tf;
+    limbo::Setup s;
+    const bool ok = Snapshot(buffer.get(), bytes.size()).Restore(&sf, &tf, &s);
+    EXPECT_TRUE(ok || s.clauses().begin() == s.clauses().end());
+    return ok;
+  };
+  EXPECT_TRUE(restores());
+
+  // An argument must refer to a term that precedes it.
+  u32 i = 0;
+  while (i < n_terms && terms[4 * i + 2] == 0) {
+    ++i;
+  }
+  ASSERT_LT(i, n_terms);
+  const u32 arg = args[terms[4 * i + 3]];
+  args[terms[4 * i + 3]] = i;
+  EXPECT_FALSE(restores());
+  args[terms[4 * i + 3]] = n_terms + 1;
+  EXPECT_FALSE(restores());
+  args[terms[4 * i + 3]] = arg;
+  EXPECT_TRUE(restores());
+
+  // Clause ends must be increasing by at least two and within the literals.
+  ends[0] = 1;
+  EXPECT_FALSE(restores());
+  ends[0] = 3;
+  EXPECT_FALSE(restores());
+  ends[0] = 2;
+  ends[1] = n_literals + 2;
+  EXPECT_FALSE(restores());
+  ends[1] = n_literals;
+  EXPECT_TRUE(restores());
+}
+
+}  // namespace limbo
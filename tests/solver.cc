@@ -3,6 +3,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 #include <limbo/solver.h>
 #include <limbo/format/output.h>
 #include <limbo/format/cpp/syntax.h>
@@ -240,5 +245,168 @@ TEST(SolverTest, Constants) {
   }
 }
 
+TEST(SolverTest, SeparateFactories) {
+  // The solvers' factories hand out the same symbol ids, and the terms are
+  // created in a different order, so their ids differ between the factories.
+  Symbol::Factory sf1;
+  Symbol::Factory sf2;
+  Term::Factory tf1;
+  Term::Factory tf2;
+  Solver solver1(&sf1, &tf1);
+  Solver solver2(&sf2, &tf2);
+  for (size_t k = 0; k < 2; ++k) {
+    Symbol::Factory* sf = k == 0 ? &sf1 : &sf2;
+    Term::Factory* tf = k == 0 ? &tf1 : &tf2;
+    Solver* solver = k == 0 ? &solver1 : &solver2;
+    Clause c1;
+    Clause c2;
+    Formula::Ref phi;
+    Formula::Ref psi;
+    {
+      Term::Factory::Context ctx(tf);
+      const Symbol::Sort s = sf->CreateSort();
+      const Symbol f = sf->CreateFunction(s, 1);
+      const Term x = tf->CreateTerm(sf->CreateVariable(s));
+      const Term n = tf->CreateTerm(sf->CreateName(s));
+      const Term m = tf->CreateTerm(sf->CreateName(s));
+      if (k == 1) {
+        tf->CreateTerm(f, {m});
+      }
+      c1 = Clause{Literal::Eq(tf->CreateTerm(f, {x}), n)};
+      c2 = Clause{Literal::Eq(tf->CreateTerm(f, {m}), m), Literal::Eq(tf->CreateTerm(f, {n}), m)};
+      phi = Formula::Factory::Atomic(Clause{Literal::Eq(tf->CreateTerm(f, {m}), n)});
+      psi = Formula::Factory::Atomic(Clause{Literal::Eq(tf->CreateTerm(f, {m}), m)});
+    }
+    solver->grounder().AddClause(c1);
+    solver->grounder().AddClause(c2);
+    EXPECT_TRUE(solver->Entails(0, *phi, Solver::kConsistencyGuarantee));
+    EXPECT_FALSE(solver->Entails(0, *psi, Solver::kConsistencyGuarantee));
+    EXPECT_FALSE(solver->Consistent(0, *psi, Solver::kConsistencyGuarantee));
+  }
+}
+
+TEST(SolverTest, ParallelGrounding) {
+  Context ctx;
+  auto Bool = ctx.CreateSort();
+  auto T = ctx.CreateName(Bool);
+  auto Obj = ctx.CreateSort();
+  auto P = ctx.CreateFunction(Bool, 1);
+  auto Q = ctx.CreateFunction(Bool, 2);
+  auto R = ctx.CreateFunction(Bool, 1);
+  auto x = ctx.CreateVariable(Obj);
+  auto y = ctx.CreateVariable(Obj);
+  std::vector<Clause> units1;
+  std::vector<Clause> units2;
+  for (size_t i = 0; i < 60; ++i) {
+    units1.push_back((P(ctx.CreateName(Obj)) == T).as_clause());
+    units2.push_back((R(ctx.CreateName(Obj)) == T).as_clause());
+  }
+  const Clause c = (P(x) != T || Q(x,y) == T || R(y) != T).as_clause();
+
+  // The solvers' plus-names differ, so we only compare the clauses without
+  // them. The clauses must be added in the same order, so they are compared
+  // by their index in the setup.
+  std::unordered_set<Term> names{T};
+  for (const Clause& c : units1) { names.insert(c[0].lhs().arg(0)); }
+  for (const Clause& c : units2) { names.insert(c[0].lhs().arg(0)); }
+  auto setup_clauses = [&names](const Solver& solver) {
+    std::vector<std::pair<size_t, Clause>> cs;
+    for (size_t i : solver.setup().clauses()) {
+      const Clause c(solver.setup().clause(i));
+      if (c.all([&names](Literal a) {
+        return names.count(a.rhs()) > 0 &&
+               std::all_of(a.lhs().args().begin(), a.lhs().args().end(), [&names](Term n) { return names.count(n); });
+      })) {
+        cs.push_back(std::make_pair(i, c));
+      }
+    }
+    return cs;
+  };
+  Solver serial(ctx.sf(), ctx.tf());
+  Solver parallel(ctx.sf(), ctx.tf());
+  parallel.grounder().set_n_threads(4);
+  EXPECT_EQ(parallel.grounder().n_threads(), 4u);
+  // The parallel solver also memoizes, with one memo per thread.
+  parallel.grounder().set_memo_slots(1 << 12);
+  for (Solver* solver : {&serial, &parallel}) {
+    solver->grounder().AddClauses(units1.begin(), units1.end());
+    solver->grounder().AddClause(c);
+  }
+  EXPECT_EQ(setup_clauses(serial), setup_clauses(parallel));
+  for (Solver* solver : {&serial, &parallel}) {
+    solver->grounder().AddClauses(units2.begin(), units2.end());
+  }
+  EXPECT_EQ(setup_clauses(serial), setup_clauses(parallel));
+  EXPECT_GT(setup_clauses(parallel).size(), 60u * 60u);
+  EXPECT_GT(parallel.grounder().n_memo_hits(), 0u);
+  for (const Clause& a : units1) {
+    for (const Clause& b : {units2[0], units2[59]}) {
+      auto phi = (Q(a[0].lhs().arg(0), b[0].lhs().arg(0)) == T)->NF(ctx.sf(), ctx.tf());
+      EXPECT_TRUE(serial.Entails(0, *phi, Solver::kConsistencyGuarantee));
+      EXPECT_TRUE(parallel.Entails(0, *phi, Solver::kConsistencyGuarantee));
+    }
+  }
+}
+
+TEST(SolverTest, LazyGrounding) {
+  Context ctx;
+  auto Bool = ctx.CreateSort();
+  auto T = ctx.CreateName(Bool);
+  auto Obj = ctx.CreateSort();
+  auto Edge = ctx.CreateFunction(Bool, 2);
+  auto Near = ctx.CreateFunction(Bool, 2);
+  auto Next = ctx.CreateFunction(Obj, 1);
+  auto x = ctx.CreateVariable(Obj);
+  auto y = ctx.CreateVariable(Obj);
+  std::vector<HiTerm> ns;
+  for (size_t i = 0; i < 8; ++i) {
+    ns.push_back(ctx.CreateName(Obj));
+  }
+  std::vector<Clause> cs;
+  for (size_t i = 0; i + 1 < ns.size(); ++i) {
+    cs.push_back((Edge(ns[i], ns[i+1]) == T).as_clause());
+  }
+  cs.push_back((Next(ns[0]) == ns[1] || Next(ns[0]) == ns[2]).as_clause());
+  cs.push_back((Edge(x,y) != T || Near(x,y) == T).as_clause());
+  cs.push_back((Next(x) != y || Near(x,y) == T).as_clause());
+
+  Solver eager(ctx.sf(), ctx.tf());
+  Solver lazy(ctx.sf(), ctx.tf());
+  lazy.grounder().set_lazy(true);
+  EXPECT_TRUE(lazy.grounder().lazy());
+  for (Solver* solver : {&eager, &lazy}) {
+    solver->grounder().AddClauses(cs.begin(), cs.end());
+  }
+  EXPECT_LT(lazy.grounder().n_generated_clauses(), eager.grounder().n_generated_clauses());
+
+  std::vector<Formula::Ref> phis;
+  phis.push_back((Near(ns[0], ns[1]) == T)->NF(ctx.sf(), ctx.tf()));
+  phis.push_back((Near(ns[1], ns[0]) == T)->NF(ctx.sf(), ctx.tf()));
+  phis.push_back((Near(ns[0], ns[1]) == T && Near(ns[5], ns[6]) == T)->NF(ctx.sf(), ctx.tf()));
+  phis.push_back(Ex(x, Near(ns[0], x) == T)->NF(ctx.sf(), ctx.tf()));
+  phis.push_back(Ex(x, Near(x, ns[0]) == T)->NF(ctx.sf(), ctx.tf()));
+  phis.push_back(Fa(x, Ex(y, Near(x, y) == T))->NF(ctx.sf(), ctx.tf()));
+  phis.push_back(Ex(x, Near(ns[0], x) == T && Next(ns[0]) == x)->NF(ctx.sf(), ctx.tf()));
+  for (const Formula::Ref& phi : phis) {
+    for (Formula::belief_level k : {0, 1}) {
+      for (bool assume_consistent : {Solver::kConsistencyGuarantee, Solver::kNoConsistencyGuarantee}) {
+        EXPECT_EQ(eager.Entails(k, *phi, assume_consistent), lazy.Entails(k, *phi, assume_consistent));
+        EXPECT_EQ(eager.EntailsComplete(k, *phi, assume_consistent), lazy.EntailsComplete(k, *phi, assume_consistent));
+      }
+    }
+  }
+  EXPECT_TRUE(lazy.Entails(0, *phis[3], Solver::kConsistencyGuarantee));
+  EXPECT_TRUE(lazy.Entails(1, *phis[6], Solver::kConsistencyGuarantee));
+  EXPECT_FALSE(lazy.Entails(1, *phis[1], Solver::kConsistencyGuarantee));
+  // A repeated query reuses the cached relevant clauses.
+  const Formula::Ref psi = Ex(x, Near(ns[2], x) == T)->NF(ctx.sf(), ctx.tf());
+  size_t n_generated_clauses[3] = {lazy.grounder().n_generated_clauses()};
+  for (size_t i = 1; i < 3; ++i) {
+    EXPECT_TRUE(lazy.Entails(0, *psi, Solver::kConsistencyGuarantee));
+    n_generated_clauses[i] = lazy.grounder().n_generated_clauses();
+  }
+  EXPECT_LT(n_generated_clauses[2] - n_generated_clauses[1], n_generated_clauses[1] - n_generated_clauses[0]);
+}
+
 }  // namespace limbo
 
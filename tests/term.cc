@@ -3,6 +3,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <limbo/term.h>
 #include <limbo/format/output.h>
 
@@ -151,5 +156,281 @@ TEST(TermTest, Isomorphic) {
   { auto u = Term::Isomorphic(fn2n1, fn1n1); EXPECT_FALSE(bool(u)); }
 }
 
+TEST(TermTest, interning) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Symbol f = sf.CreateFunction(s1, 2);
+  const Symbol g = sf.CreateFunction(s1, 1);
+  std::vector<Term> ns;
+  for (size_t i = 0; i < 100; ++i) {
+    ns.push_back(tf.CreateTerm(sf.CreateName(s1)));
+  }
+  std::vector<Term> ts;
+  for (Term n1 : ns) {
+    for (Term n2 : ns) {
+      ts.push_back(tf.CreateTerm(f, {n1, n2}));
+    }
+  }
+  size_t i = 0;
+  for (Term n1 : ns) {
+    for (Term n2 : ns) {
+      const Term args[] = {n1, n2};
+      const Term t = tf.CreateTerm(f, args, args + 2);
+      EXPECT_EQ(t, ts[i++]);
+      EXPECT_EQ(t.args().size(), 2u);
+      EXPECT_EQ(t.arg(0), n1);
+      EXPECT_EQ(t.arg(1), n2);
+      EXPECT_EQ(std::vector<Term>(t.args().begin(), t.args().end()), std::vector<Term>({n1, n2}));
+    }
+  }
+  const Term t1 = tf.CreateTerm(g, {ts[0]});
+  const Term t2 = tf.CreateTerm(g, {ts[1]});
+  EXPECT_NE(t1, t2);
+  EXPECT_EQ(t1.args(), tf.CreateTerm(g, {ts[0]}).args());
+  EXPECT_NE(t1.args(), t2.args());
+  EXPECT_TRUE(ns[0].args().empty());
+}
+
+TEST(TermTest, large_arity) {
+  // The arguments of these terms fill several segments of the argument pool.
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const size_t arity = 250;
+  Term::Vector ns;
+  for (size_t i = 0; i < arity + 100; ++i) {
+    ns.push_back(tf.CreateTerm(sf.CreateName(s1)));
+  }
+  const Symbol f = sf.CreateFunction(s1, arity);
+  std::vector<Term> ts;
+  for (size_t k = 0; k < 100; ++k) {
+    ts.push_back(tf.CreateTerm(f, Term::Vector(ns.begin() + k, ns.begin() + k + arity)));
+  }
+  for (size_t k = 0; k < ts.size(); ++k) {
+    EXPECT_EQ(ts[k], tf.CreateTerm(f, Term::Vector(ns.begin() + k, ns.begin() + k + arity)));
+    EXPECT_EQ(ts[k].args().size(), arity);
+    EXPECT_TRUE(std::equal(ts[k].args().begin(), ts[k].args().end(), ns.begin() + k));
+    EXPECT_TRUE(ts[k].primitive());
+  }
+}
+
+TEST(TermTest, attributes) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Symbol::Sort s2 = sf.CreateSort();
+  const Term n = tf.CreateTerm(sf.CreateName(s1));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s1));
+  const Symbol f = sf.CreateFunction(s2, 2);
+  const Symbol g = sf.CreateFunction(s1, 1);
+  const Term fnn = tf.CreateTerm(f, {n, n});
+  const Term fnx = tf.CreateTerm(f, {n, x});
+  const Term gfnn = tf.CreateTerm(g, {fnn});
+  const Term gfnx = tf.CreateTerm(g, {fnx});
+  const Term c = tf.CreateTerm(sf.CreateFunction(s1, 0));
+
+  EXPECT_TRUE(n.ground() && !n.primitive() && !n.quasiprimitive());
+  EXPECT_TRUE(!x.ground() && !x.primitive() && !x.quasiprimitive());
+  EXPECT_TRUE(c.ground() && c.primitive() && c.quasiprimitive());
+  EXPECT_TRUE(fnn.ground() && fnn.primitive() && fnn.quasiprimitive());
+  EXPECT_TRUE(!fnx.ground() && !fnx.primitive() && fnx.quasiprimitive());
+  EXPECT_TRUE(gfnn.ground() && !gfnn.primitive() && !gfnn.quasiprimitive());
+  EXPECT_TRUE(!gfnx.ground() && !gfnx.primitive() && !gfnx.quasiprimitive());
+  EXPECT_EQ(fnn.sort(), s2);
+  EXPECT_EQ(gfnx.sort(), s1);
+  EXPECT_EQ(fnx.arity(), 2);
+  EXPECT_TRUE(fnx.function() && !fnx.variable() && !fnx.name());
+}
+
+TEST(TermTest, concurrent) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Symbol f = sf.CreateFunction(s1, 2);
+  const Symbol g = sf.CreateFunction(s1, 1);
+  std::vector<Term> ns;
+  for (size_t i = 0; i < 50; ++i) {
+    ns.push_back(tf.CreateTerm(sf.CreateName(s1)));
+  }
+  const size_t n_threads = 8;
+  std::vector<std::vector<Term>> ts(n_threads);
+  std::vector<std::thread> threads;
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&, k]() {
+      for (size_t i = 0; i < ns.size(); ++i) {
+        for (size_t j = 0; j < ns.size(); ++j) {
+          const Term n1 = ns[(i + k) % ns.size()];
+          const Term n2 = ns[j];
+          ts[k].push_back(tf.CreateTerm(g, {tf.CreateTerm(f, {n1, n2})}));
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (size_t k = 0; k < n_threads; ++k) {
+    for (size_t i = 0; i < ns.size(); ++i) {
+      for (size_t j = 0; j < ns.size(); ++j) {
+        const Term t = ts[k][i * ns.size() + j];
+        EXPECT_EQ(t, ts[0][((i + k) % ns.size()) * ns.size() + j]);
+        EXPECT_EQ(t.symbol(), g);
+        EXPECT_EQ(t.arg(0).arg(0), ns[(i + k) % ns.size()]);
+        EXPECT_EQ(t.arg(0).arg(1), ns[j]);
+        EXPECT_TRUE(t.ground() && !t.primitive() && t.arg(0).primitive());
+      }
+    }
+  }
+}
+
+TEST(TermTest, concurrent_creation) {
+  Symbol::Factory sf;
+  Term::Factory tf;
+  Term::Factory::Context ctx(&tf);
+  const Symbol::Sort s1 = sf.CreateSort();
+  std::vector<Term> ns;
+  for (size_t i = 0; i < 2000; ++i) {
+    ns.push_back(tf.CreateTerm(sf.CreateName(s1)));
+  }
+  const size_t n_threads = 8;
+  std::vector<Symbol> fs;
+  for (size_t k = 0; k < n_threads; ++k) {
+    fs.push_back(sf.CreateFunction(s1, 1));
+  }
+  const Symbol g = sf.CreateFunction(s1, 1);
+  std::vector<size_t> errors(n_threads, 0);
+  std::vector<std::thread> threads;
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&, k]() {
+      Term::Factory::Context ctx(&tf);
+      for (size_t i = 0; i < ns.size(); ++i) {
+        // Each thread creates its own terms and a shared one, so new terms
+        // race for the same empty slots.
+        const Term n = ns[(i + k * ns.size() / n_threads) % ns.size()];
+        for (const Symbol f : {fs[k], g}) {
+          const Term t = tf.CreateTerm(f, {n});
+          if (t.symbol() != f || t.args().size() != 1 || t.arg(0) != n) {
+            ++errors[k];
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (size_t k = 0; k < n_threads; ++k) {
+    EXPECT_EQ(errors[k], 0u);
+  }
+}
+
+TEST(TermTest, contexts) {
+  Symbol::Factory sf;
+  std::unique_ptr<Term::Factory> tf1(new Term::Factory());
+  std::unique_ptr<Term::Factory> tf2(new Term::Factory());
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Symbol n = sf.CreateName(s1);
+  const Symbol f = sf.CreateFunction(s1, 1);
+  const Symbol g = sf.CreateFunction(s1, 2);
+
+  Term f1;
+  Term g2;
+  {
+    Term::Factory::Context ctx(tf1.get());
+    EXPECT_EQ(Term::Factory::Instance(), tf1.get());
+    f1 = tf1->CreateTerm(f, {tf1->CreateTerm(n)});
+    EXPECT_EQ(f1.symbol(), f);
+    EXPECT_EQ(f1.arg(0).symbol(), n);
+    EXPECT_TRUE(f1.ground() && f1.primitive());
+    {
+      Term::Factory::Context ctx(tf2.get());
+      EXPECT_EQ(Term::Factory::Instance(), tf2.get());
+      const Term n2 = tf2->CreateTerm(n);
+      g2 = tf2->CreateTerm(g, {n2, n2});
+      EXPECT_EQ(g2.symbol(), g);
+      EXPECT_EQ(g2.arg(1), n2);
+      Term::Factory* tf = tf2.get();
+      std::thread t([tf]() { EXPECT_NE(Term::Factory::Instance(), tf); });
+      t.join();
+    }
+    EXPECT_EQ(Term::Factory::Instance(), tf1.get());
+    EXPECT_EQ(f1.symbol(), f);
+  }
+  EXPECT_NE(Term::Factory::Instance(), tf1.get());
+  EXPECT_NE(Term::Factory::Instance(), tf2.get());
+  tf1.reset();
+  {
+    Term::Factory::Context ctx(tf2.get());
+    EXPECT_EQ(g2.symbol(), g);
+    EXPECT_EQ(tf2->CreateTerm(g, {g2.arg(0), g2.arg(1)}), g2);
+  }
+}
+
+TEST(TermTest, SubstitutionMemo) {
+  Symbol::Factory& sf = *Symbol::Factory::Instance();
+  Term::Factory& tf = *Term::Factory::Instance();
+  const Symbol::Sort s1 = sf.CreateSort();
+  const Term n1 = tf.CreateTerm(sf.CreateName(s1));
+  const Term n2 = tf.CreateTerm(sf.CreateName(s1));
+  const Term x = tf.CreateTerm(sf.CreateVariable(s1));
+  const Term y = tf.CreateTerm(sf.CreateVariable(s1));
+  const Symbol f = sf.CreateFunction(s1, 2);
+  const Symbol g = sf.CreateFunction(s1, 1);
+  const Term fxn1 = tf.CreateTerm(f, {x, n1});
+  const Term gfxn1 = tf.CreateTerm(g, {fxn1});
+  const Term fxy = tf.CreateTerm(f, {x, y});
+
+  Term::SubstitutionMemo memo(16);
+  Term::Substitution theta1(x, n1);
+  Term::Substitution theta2(x, n2);
+  theta2.Add(y, n1);
+  EXPECT_EQ(fxn1.Substitute(memo.Memoize(theta1, &tf), &tf), tf.CreateTerm(f, {n1, n1}));
+  EXPECT_EQ(memo.n_hits(), 0u);
+  EXPECT_EQ(memo.n_misses(), 1u);
+  EXPECT_EQ(fxn1.Substitute(memo.Memoize(theta1, &tf), &tf), tf.CreateTerm(f, {n1, n1}));
+  EXPECT_EQ(memo.n_hits(), 1u);
+  EXPECT_EQ(fxn1.Substitute(memo.Memoize(theta2, &tf), &tf), tf.CreateTerm(f, {n2, n1}));
+  EXPECT_EQ(memo.n_misses(), 2u);
+  // y does not occur in f(x,n1), so theta2 and theta3 are the same for it.
+  Term::Substitution theta3(x, n2);
+  theta3.Add(y, n2);
+  EXPECT_EQ(fxn1.Substitute(memo.Memoize(theta3, &tf), &tf), tf.CreateTerm(f, {n2, n1}));
+  EXPECT_EQ(memo.n_hits(), 2u);
+  EXPECT_EQ(fxy.Substitute(memo.Memoize(theta2, &tf), &tf), tf.CreateTerm(f, {n2, n1}));
+  EXPECT_EQ(fxy.Substitute(memo.Memoize(theta3, &tf), &tf), tf.CreateTerm(f, {n2, n2}));
+  EXPECT_EQ(fxy.Substitute(memo.Memoize(theta1, &tf), &tf), tf.CreateTerm(f, {n1, y}));
+  EXPECT_EQ(gfxn1.Substitute(memo.Memoize(theta1, &tf), &tf), tf.CreateTerm(g, {tf.CreateTerm(f, {n1, n1})}));
+  EXPECT_EQ(n1.Substitute(memo.Memoize(theta1, &tf), &tf), n1);
+  EXPECT_EQ(x.Substitute(memo.Memoize(theta1, &tf), &tf), n1);
+  EXPECT_EQ(y.Substitute(memo.Memoize(theta1, &tf), &tf), y);
+
+  // Terms with more variables than the memo handles are substituted, too.
+  Term::Vector vars;
+  Term::Vector names;
+  Term::Substitution theta4;
+  for (size_t i = 0; i <= Term::SubstitutionMemo::kMaxVars; ++i) {
+    vars.push_back(tf.CreateTerm(sf.CreateVariable(s1)));
+    names.push_back(tf.CreateTerm(sf.CreateName(s1)));
+    theta4.Add(vars.back(), names.back());
+  }
+  const Symbol h = sf.CreateFunction(s1, vars.size());
+  EXPECT_EQ(tf.CreateTerm(h, vars).Substitute(memo.Memoize(theta4, &tf), &tf), tf.CreateTerm(h, names));
+  EXPECT_EQ(tf.CreateTerm(h, vars).Substitute(memo.Memoize(theta4, &tf), &tf), tf.CreateTerm(h, names));
+
+  memo.Clear();
+  const size_t n_misses = memo.n_misses();
+  EXPECT_EQ(fxn1.Substitute(memo.Memoize(theta1, &tf), &tf), tf.CreateTerm(f, {n1, n1}));
+  EXPECT_EQ(memo.n_misses(), n_misses + 1);
+
+  // Lookup() is keyed on the term and the values of its variables.
+  size_t n_created = 0;
+  auto create = [&]() { ++n_created; return tf.CreateTerm(f, {n2, n2}); };
+  const Term values[] = {n2, n2};
+  EXPECT_EQ(memo.Lookup(fxy, values, 2, create), tf.CreateTerm(f, {n2, n2}));
+  EXPECT_EQ(memo.Lookup(fxy, values, 2, create), tf.CreateTerm(f, {n2, n2}));
+  EXPECT_EQ(n_created, 1u);
+}
+
 }  // namespace limbo
 